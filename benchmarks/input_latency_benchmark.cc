@@ -0,0 +1,51 @@
+#include "em/em.h"
+#include "support/misc.h"
+
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+int main(int argc, char *argv[]) {
+  using namespace emcc;
+  using namespace emcc::editor;
+  if (argc < 2 || argc > 5)
+    Die("Usage: {} <filename> [max_fps] [num_keys] [key_interval_us]",
+        argv[0]);
+  std::string filename(argv[1]);
+  const int max_fps = argc > 2 ? std::stoi(argv[2]) : 60;
+  const size_t num_keys = argc > 3 ? std::stoul(argv[3]) : 1000;
+  const auto key_interval =
+      std::chrono::microseconds(argc > 4 ? std::stoul(argv[4]) : 1000);
+  auto buffer = MonoBuffer::CreateFromFile(filename);
+  if (!buffer)
+    Die("Failed to open {}", filename.c_str());
+  int fds[2];
+  if (::pipe(fds) != 0)
+    Die("Failed to create pipe");
+  const int out = ::open("/dev/null", O_WRONLY);
+  tui::ANSITerminal vt(fds[0], out);
+  BufferView view(buffer.get(), 50, 80);
+  Window window(50, 80, view, vt, max_fps);
+  // Keys like a held key repeating, then ESC to stop.
+  std::thread keys([&] {
+    for (size_t i = 0; i < num_keys; ++i) {
+      ::write(fds[1], "j", 1);
+      std::this_thread::sleep_for(key_interval);
+    }
+    ::write(fds[1], "\x1B", 1);
+  });
+  const int status = window.Run(fds[0]);
+  keys.join();
+  const Histogram &latency = window.input_latency();
+  std::cout << "status: " << status << std::endl;
+  std::cout << "keys: " << latency.count() << std::endl;
+  std::cout << "frames: " << window.num_frames() << std::endl;
+  std::cout << "bytes written: " << vt.bytes_written() << std::endl;
+  std::cout << "latency p50: " << latency.Percentile(0.5) << "us" << std::endl;
+  std::cout << "latency p99: " << latency.Percentile(0.99) << "us"
+            << std::endl;
+  std::cout << "latency max: " << latency.max() << "us" << std::endl;
+  return 0;
+}
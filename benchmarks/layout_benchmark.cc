@@ -0,0 +1,65 @@
+#include "editor/line_view.h"
+#include "support/misc.h"
+#include "support/utf8_scan.h"
+#include "support/wcwidth.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+template <typename F>
+static double MeasureSeconds(F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  using namespace emcc;
+  using namespace emcc::editor;
+  if (argc < 2 || argc > 3)
+    Die("Usage: {} <filename> [rounds]", argv[0]);
+  std::string filename(argv[1]);
+  size_t rounds = argc == 3 ? std::stoul(argv[2]) : 100;
+  auto buffer = MonoBuffer::CreateFromFile(filename);
+  if (!buffer)
+    Die("Failed to open {}", filename.c_str());
+  if (!buffer->IsUTF8Encoded())
+    Die("Unable to handle non-utf8 encoded files");
+  std::string content;
+  buffer->Read(0, buffer->size(), content);
+  std::vector<uint32_t> runes;
+  DecodeUTF8(content.data(), content.size(),
+             [&runes](size_t, uint32_t rune) { runes.push_back(rune); });
+  // Widths of all runes, by the table and by searching intervals.
+  long checksum = 0;
+  double table = MeasureSeconds([&] {
+    for (size_t i = 0; i < rounds; ++i)
+      for (uint32_t rune : runes)
+        checksum += wchar_width(rune) + wchar_width_cjk(rune);
+  });
+  double bisearch = MeasureSeconds([&] {
+    for (size_t i = 0; i < rounds; ++i)
+      for (uint32_t rune : runes)
+        checksum -= wchar_width_bisearch(rune) + wchar_width_cjk_bisearch(rune);
+  });
+  // Layout of every line, width lookups are a part of it.
+  size_t rows = 0;
+  double layout = MeasureSeconds([&] {
+    LineView line;
+    for (size_t i = 0; i < rounds; ++i) {
+      for (size_t j = 0; j < buffer->NumLines(); ++j) {
+        line = LineView(buffer.get(), j, 80);
+        rows += line.height();
+      }
+    }
+  });
+  std::cout << "runes: " << runes.size() * rounds << std::endl;
+  std::cout << "table lookup: " << table << "s" << std::endl;
+  std::cout << "interval search: " << bisearch << "s" << std::endl;
+  std::cout << "layout: " << layout << "s, " << rows << " rows" << std::endl;
+  std::cout << "checksum: " << checksum << std::endl;
+  return 0;
+}
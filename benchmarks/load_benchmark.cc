@@ -0,0 +1,51 @@
+#include "core/mono_buffer.h"
+#include "support/misc.h"
+#include "support/sys.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+  using namespace emcc;
+  using namespace emcc::editor;
+  if (argc < 2 || argc > 4)
+    Die("Usage: {} <filename> [num_threads] [mmap,background]", argv[0]);
+  std::string filename(argv[1]);
+  LoadOptions options;
+  if (argc >= 3)
+    options.num_threads = std::stoul(argv[2]);
+  if (argc >= 4) {
+    std::string flags(argv[3]);
+    options.mmap = flags.find("mmap") != std::string::npos;
+    options.background_index = flags.find("background") != std::string::npos;
+  }
+  auto start = std::chrono::high_resolution_clock::now();
+  auto elapsed = [&start] {
+    auto end = std::chrono::high_resolution_clock::now();
+    return 1 / 1e6 *
+           std::chrono::duration_cast<std::chrono::microseconds>(end - start)
+               .count();
+  };
+  auto buffer = MonoBuffer::CreateFromFile(filename, options);
+  if (!buffer)
+    Die("Failed to open {}", filename.c_str());
+  if (options.background_index) {
+    // Lines needed by the first page.
+    buffer->WaitForLine(100);
+    std::cout << "first page: " << elapsed() << std::endl;
+    buffer->WaitForOffset(buffer->size());
+  }
+  float secs = elapsed();
+  std::cout << "time elapsed: " << secs << std::endl;
+  std::cout << "bytes: " << buffer->size() << std::endl;
+  std::cout << "lines: " << buffer->NumLines() << std::endl;
+  std::cout << "MB/s: " << buffer->size() / secs / (1UL << 20) << std::endl;
+  start = std::chrono::high_resolution_clock::now();
+  bool utf8 = buffer->IsUTF8Encoded();
+  secs = elapsed();
+  std::cout << "utf8 validation: " << secs << "s, "
+            << (utf8 ? "valid" : "invalid")
+            << ", MB/s: " << buffer->size() / secs / (1UL << 20) << std::endl;
+  return 0;
+}
@@ -5,8 +5,6 @@
 #include "tui/renderer.h"
 
 #include <chrono>
-#include <codecvt>
-#include <locale>
 #include <string>
 #include <thread>
 
@@ -31,13 +29,17 @@ int main(int argc, char *argv[]) {
   int height, width;
   vt.GetMaxYX(height, width);
   BufferView view(buffer.get(), height, width);
+  emcc::tui::Screen screen(height, width);
   {
     start = std::chrono::high_resolution_clock::now();
     size_t total_lines = buffer->NumLines();
-    for (size_t i = std::min(total_lines - 1, start_line);
-         i < std::min(total_lines, end_line); ++i) {
+    start_line = std::min(total_lines - 1, start_line);
+    end_line = std::min(total_lines, end_line);
+    // Scroll backwards if start_line is after end_line.
+    const bool reverse = start_line > end_line;
+    for (size_t i = start_line; i != end_line; reverse ? --i : ++i) {
       view.RePosition(i);
-      emcc::tui::RenderBufferView(view, vt, height, width);
+      emcc::tui::RenderBufferView(view, screen, vt);
       ++nr_frames;
     }
     end = std::chrono::high_resolution_clock::now();
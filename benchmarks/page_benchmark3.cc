@@ -52,8 +52,11 @@ int main(int argc, char *argv[]) {
     noecho();
     start = std::chrono::high_resolution_clock::now();
     size_t total_lines = buffer->NumLines();
-    for (size_t i = std::min(total_lines - 1, start_line);
-         i < std::min(total_lines, end_line); ++i) {
+    start_line = std::min(total_lines - 1, start_line);
+    end_line = std::min(total_lines, end_line);
+    // Scroll backwards if start_line is after end_line.
+    const bool reverse = start_line > end_line;
+    for (size_t i = start_line; i != end_line; reverse ? --i : ++i) {
       view.RePosition(i);
       Render(view, height, width);
       ++nr_frames;
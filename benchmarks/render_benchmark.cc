@@ -0,0 +1,80 @@
+#include "editor/buffer_view.h"
+#include "support/misc.h"
+#include "support/sys.h"
+#include "tui/renderer.h"
+
+#include <fcntl.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+
+// Count allocations made while rendering, which should be none once the
+// screen and terminal buffers are warmed up.
+static std::atomic<size_t> num_allocations;
+
+void *operator new(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+int main(int argc, char *argv[]) {
+  using namespace emcc;
+  using namespace emcc::editor;
+  if (argc != 4)
+    Die("Usage: {} <filename> <start_line> <end_line>", argv[0]);
+  std::string filename(argv[1]);
+  size_t start_line = std::stoul(argv[2]);
+  size_t end_line = std::stoul(argv[3]);
+  auto buffer = editor::MonoBuffer::CreateFromFile(filename);
+  if (!buffer)
+    Die("Failed to open {}", filename.c_str());
+  if (!buffer->IsUTF8Encoded())
+    Die("Unable to handle non-utf8 encoded files");
+  int out = ::open("/dev/null", O_WRONLY);
+  if (out < 0)
+    Die("Failed to open /dev/null");
+  // The size of a common terminal, output is discarded.
+  const int height = 50, width = 200;
+  emcc::tui::ANSITerminal vt(STDIN_FILENO, out);
+  BufferView view(buffer.get(), height, width);
+  emcc::tui::Screen screen(height, width);
+  size_t total_lines = buffer->NumLines();
+  start_line = std::min(total_lines - 1, start_line);
+  end_line = std::min(total_lines, end_line);
+  // Warm up buffers of screen and terminal.
+  view.RePosition(start_line);
+  emcc::tui::RenderBufferView(view, screen, vt);
+  std::chrono::nanoseconds elapsed(0);
+  size_t nr_frames = 0, allocations = 0, bytes = 0;
+  for (size_t i = start_line; i < end_line; ++i) {
+    view.RePosition(i);
+    size_t before = num_allocations.load(std::memory_order_relaxed),
+           written = vt.bytes_written();
+    auto start = std::chrono::steady_clock::now();
+    emcc::tui::RenderBufferView(view, screen, vt);
+    elapsed += std::chrono::steady_clock::now() - start;
+    allocations += num_allocations.load(std::memory_order_relaxed) - before;
+    bytes += vt.bytes_written() - written;
+    ++nr_frames;
+  }
+  ::close(out);
+  double secs = std::chrono::duration<double>(elapsed).count();
+  std::cout << "time elapsed: " << secs << std::endl;
+  std::cout << "frames: " << nr_frames << std::endl;
+  std::cout << "fps: " << nr_frames / secs << std::endl;
+  std::cout << "allocations per frame: "
+            << double(allocations) / std::max(nr_frames, 1UL) << std::endl;
+  std::cout << "bytes per frame: " << double(bytes) / std::max(nr_frames, 1UL)
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,58 @@
+#include "editor/buffer_view.h"
+#include "editor/wrap_index.h"
+#include "support/misc.h"
+#include "support/thread_pool.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+template <typename F>
+static double MeasureSeconds(F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  using namespace emcc;
+  using namespace emcc::editor;
+  if (argc < 2 || argc > 3)
+    Die("Usage: {} <filename> [num_threads]", argv[0]);
+  std::string filename(argv[1]);
+  const size_t num_threads =
+      argc == 3 ? std::stoul(argv[2]) : std::thread::hardware_concurrency();
+  LoadOptions options;
+  options.mmap = true;
+  auto buffer = MonoBuffer::CreateFromFile(filename, options);
+  if (!buffer)
+    Die("Failed to open {}", filename.c_str());
+  ThreadPool pool(num_threads);
+  BufferView view(buffer.get(), 50, 80, nullptr, &pool);
+  WrapIndex index(buffer.get(), 80, &pool);
+  // Rows in view are laid out at once, like a frame after SIGWINCH.
+  const size_t line = buffer->NumLines() / 2;
+  view.RePosition(line);
+  double first_frame = MeasureSeconds([&] {
+    view.Resize(50, 100);
+    index.Resize(100);
+    index.Layout(line, line + 50);
+  });
+  double background = MeasureSeconds([&] {
+    while (!index.Sync())
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  });
+  index.Resize(80);
+  double serial = MeasureSeconds([&] {
+    while (index.Refine(1000))
+      ;
+  });
+  std::cout << "lines: " << buffer->NumLines() << std::endl;
+  std::cout << "first frame: " << first_frame * 1e3 << "ms" << std::endl;
+  std::cout << "background layout on " << pool.size()
+            << " threads: " << background << "s" << std::endl;
+  std::cout << "serial layout: " << serial << "s" << std::endl;
+  return 0;
+}
@@ -1,9 +1,8 @@
 #include "core/line_buffer.h"
+#include "support/file_writer.h"
 #include "support/sys.h"
 
-#include <cstdio>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
 
 namespace emcc::editor {
@@ -124,21 +123,18 @@ size_t LineBuffer::Erase(size_t l, size_t column, size_t len) {
   return mid.size();
 }
 
-bool LineBuffer::SaveFile(const std::string &filename) {
-  std::string tempfile = std::tmpnam(nullptr);
-  if (tempfile.empty())
+bool LineBuffer::SaveFile(const std::string &filename, SyncPolicy policy) {
+  AtomicFileWriter writer(filename, policy);
+  if (!writer.is_open())
     return false;
-  std::ofstream out(tempfile, std::ios::binary);
-  if (!out.is_open())
-    return false;
-  std::string line;
-  for (size_t i = 0; i < CountLines(); ++i) {
-    line.clear();
-    GetLine(i, ~0U, line);
-    out << line;
-  }
-  out.close();
-  return !::rename(tempfile.c_str(), filename.c_str());
+  buffer_.Visit(0, buffer_.size(), [&writer](Line *const *lines, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      lines[i]->Visit(0, lines[i]->size(),
+                      [&writer](const char *data, size_t len) {
+                        writer.Write(data, len);
+                      });
+  });
+  return writer.Commit();
 }
 
 void LineBuffer::ComputeOffset(size_t line, size_t col, size_t &offset) {
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "support/file_writer.h"
 #include "support/prefix_sum.h"
 #include "support/rope.h"
 
@@ -33,7 +34,8 @@ public:
   size_t Erase(size_t line, size_t column, size_t len);
   size_t Erase(size_t line, size_t column, size_t len, LineBuffer &erased);
   bool Verify();
-  bool SaveFile(const std::string &filename);
+  bool SaveFile(const std::string &filename,
+                SyncPolicy policy = SyncPolicy::kFull);
   void ComputeOffset(size_t line, size_t col, size_t &offset);
 
 private:
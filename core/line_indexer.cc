@@ -0,0 +1,70 @@
+#include "core/line_indexer.h"
+#include "support/byte_scan.h"
+
+#include <algorithm>
+
+namespace emcc::editor {
+
+LineIndexer::LineIndexer(const char *data, size_t len, size_t chunk_size)
+    : data_(data), len_(len), chunk_size_(std::max(chunk_size, 1UL)),
+      indexed_(0), stop_(false), done_(false), taken_(false) {
+  thread_ = std::thread([this] { Run(); });
+}
+
+LineIndexer::~LineIndexer() {
+  stop_ = true;
+  thread_.join();
+}
+
+void LineIndexer::Run() {
+  std::vector<long> line_size;
+  size_t start = 0;
+  for (size_t offset = 0; offset < len_ && !stop_; offset += chunk_size_) {
+    const size_t len = std::min(chunk_size_, len_ - offset);
+    ForEachByte(data_ + offset, len, '\n', [&](size_t i) {
+      line_size.emplace_back(offset + i + 1 - start);
+      start = offset + i + 1;
+    });
+    if (offset + len == len_ && start < len_)
+      line_size.emplace_back(len_ - start);
+    {
+      std::unique_lock<std::mutex> l(mu_);
+      published_.insert(published_.end(), line_size.begin(), line_size.end());
+    }
+    line_size.clear();
+    indexed_ = offset + len;
+    cv_.notify_all();
+  }
+  {
+    std::unique_lock<std::mutex> l(mu_);
+    done_ = true;
+  }
+  cv_.notify_all();
+}
+
+bool LineIndexer::Take(std::vector<long> &line_size) {
+  if (published_.empty()) {
+    if (done_)
+      taken_ = true;
+    return !taken_;
+  }
+  if (line_size.empty())
+    line_size.swap(published_);
+  else
+    line_size.insert(line_size.end(), published_.begin(), published_.end());
+  published_.clear();
+  return true;
+}
+
+bool LineIndexer::Poll(std::vector<long> &line_size) {
+  std::unique_lock<std::mutex> l(mu_);
+  return Take(line_size);
+}
+
+bool LineIndexer::Wait(std::vector<long> &line_size) {
+  std::unique_lock<std::mutex> l(mu_);
+  cv_.wait(l, [this] { return done_ || !published_.empty(); });
+  return Take(line_size);
+}
+
+} // namespace emcc::editor
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace emcc::editor {
+
+// Scan sizes of lines of data on a background thread. Lines are published
+// chunk by chunk, so that they can be used before all data is indexed. Only
+// complete lines are published except the last one. data must outlive the
+// indexer.
+class LineIndexer {
+public:
+  static constexpr size_t kDefaultChunkSize = 1UL << 20;
+
+  LineIndexer(const char *data, size_t len,
+              size_t chunk_size = kDefaultChunkSize);
+  LineIndexer(const LineIndexer &) = delete;
+  ~LineIndexer();
+
+  // Move lines published so far to the end of line_size. Returns false if
+  // all lines have been taken.
+  bool Poll(std::vector<long> &line_size);
+  // Like Poll, but blocks until more lines are published.
+  bool Wait(std::vector<long> &line_size);
+  // Number of bytes indexed, for progress report.
+  size_t indexed() const { return indexed_; }
+  size_t length() const { return len_; }
+
+private:
+  void Run();
+  bool Take(std::vector<long> &line_size);
+
+  const char *const data_;
+  const size_t len_, chunk_size_;
+  std::atomic<size_t> indexed_;
+  std::atomic<bool> stop_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::vector<long> published_;
+  bool done_, taken_;
+  std::thread thread_;
+};
+
+} // namespace emcc::editor
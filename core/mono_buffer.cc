@@ -1,8 +1,12 @@
 #include "core/mono_buffer.h"
+#include "support/byte_scan.h"
+#include "support/file_writer.h"
 #include "support/misc.h"
 #include "support/sys.h"
-#include "support/utf8.h"
+#include "support/thread_pool.h"
+#include "support/utf8_scan.h"
 
+#include <cstring>
 #include <iostream>
 
 namespace emcc::editor {
@@ -28,8 +32,11 @@ MonoBuffer &MonoBuffer::Insert(size_t line, size_t col, char c) {
 
 MonoBuffer &MonoBuffer::Insert(size_t offset, char c) {
   offset = std::min(buffer_.size(), offset);
+  // Line sizes are only updated within indexed lines.
+  WaitForOffset(offset);
   size_t line, col;
   ComputePosition(offset, line, col);
+  const size_t num_lines = NumLines();
   if (line >= line_size_.size()) {
     assert(line == line_size_.size());
     line_size_.Insert(line, 0);
@@ -43,43 +50,138 @@ MonoBuffer &MonoBuffer::Insert(size_t offset, char c) {
     if (new_line_size)
       line_size_.Insert(line + 1, new_line_size);
   }
+  NotifyLinesChanged(line, line < num_lines, num_lines);
+  return *this;
+}
+
+MonoBuffer &MonoBuffer::Insert(size_t offset, std::string_view text) {
+  if (text.empty())
+    return *this;
+  offset = std::min(buffer_.size(), offset);
+  WaitForOffset(offset);
+  size_t line, col;
+  ComputePosition(offset, line, col);
+  const size_t num_lines = NumLines();
+  if (line >= line_size_.size()) {
+    assert(line == line_size_.size());
+    line_size_.Insert(line, 0);
+  }
+  buffer_.Insert(offset, text.data(), text.size());
+  std::vector<long> line_size;
+  ScanLines(text.data(), text.size(), line_size);
+  if (line_size.size() == 1 && text.back() != kNewLine) {
+    line_size_.Add(line, text.size());
+    NotifyLinesChanged(line, line < num_lines, num_lines);
+    return *this;
+  }
+  // The line is broken at col, its rest follows the last inserted line.
+  const long rest = line_size_.At(line) - col;
+  line_size_.Add(line, col + line_size.front() - line_size_.At(line));
+  if (text.back() == kNewLine)
+    line_size.emplace_back(rest);
+  else
+    line_size.back() += rest;
+  if (line_size.back() == 0)
+    line_size.pop_back();
+  line_size_.Insert(line + 1, line_size.begin() + 1, line_size.end());
+  NotifyLinesChanged(line, line < num_lines, num_lines);
   return *this;
 }
 
 MonoBuffer &MonoBuffer::Append(char c) { return Insert(buffer_.size(), c); }
 
 MonoBuffer &MonoBuffer::Append(const char *data, size_t len) {
+  return Append(data, len, false);
+}
+
+MonoBuffer &MonoBuffer::AppendView(const char *data, size_t len) {
+  return Append(data, len, true);
+}
+
+MonoBuffer &MonoBuffer::Append(const char *data, size_t len, bool view) {
+  if (len == 0)
+    return *this;
+  WaitForOffset(buffer_.size());
+  auto append = [this, view](const char *data, size_t len) {
+    if (view)
+      buffer_.AppendView(data, len);
+    else
+      buffer_.Append(data, len);
+  };
+  const size_t num_lines = NumLines();
   size_t i = 0;
   if (!buffer_.empty() && buffer_.At(buffer_.size() - 1) != kNewLine) {
-    for (; i < len; ++i) {
-      Append(data[i]);
-      if (data[i] == kNewLine) {
-        ++i;
-        break;
-      }
-    }
+    // Complete the last line first.
+    const void *nl = ::memchr(data, kNewLine, len);
+    i = nl ? static_cast<const char *>(nl) - data + 1 : len;
+    append(data, i);
+    line_size_.Add(NumLines() - 1, i);
   }
-  if (i >= len) {
-    return *this;
+  if (i < len) {
+    assert(buffer_.empty() || buffer_.At(buffer_.size() - 1) == kNewLine);
+    append(data + i, len - i);
+    std::vector<long> line_size;
+    ScanLines(data + i, len - i, line_size);
+    line_size_.Append(line_size.begin(), line_size.end());
   }
-  assert(buffer_.empty() || buffer_.At(buffer_.size() - 1) == kNewLine);
-  buffer_.Append(data + i, len - i);
-  size_t current = 0;
-  for (; i < len; ++i) {
-    ++current;
-    if (data[i] == kNewLine) {
-      assert(current);
-      line_size_.Insert(NumLines(), current);
-      current = 0;
-    }
-  }
-  if (current)
-    line_size_.Insert(NumLines(), current);
+  const size_t line = num_lines - (i > 0);
+  NotifyLinesChanged(line, num_lines - line, num_lines);
   return *this;
 }
 
+void MonoBuffer::ScanLines(const char *data, size_t len,
+                           std::vector<long> &line_size) {
+  size_t start = 0;
+  ForEachByte(data, len, kNewLine, [&](size_t i) {
+    line_size.emplace_back(i + 1 - start);
+    start = i + 1;
+  });
+  if (start < len)
+    line_size.emplace_back(len - start);
+}
+
+bool MonoBuffer::SyncIndex() {
+  if (!indexer_)
+    return true;
+  std::vector<long> line_size;
+  if (!indexer_->Poll(line_size)) {
+    indexer_.reset();
+    return true;
+  }
+  const size_t num_lines = NumLines();
+  line_size_.Append(line_size.begin(), line_size.end());
+  NotifyLinesChanged(num_lines, 0, num_lines);
+  return false;
+}
+
+bool MonoBuffer::WaitForIndex() {
+  if (!indexer_)
+    return false;
+  std::vector<long> line_size;
+  if (!indexer_->Wait(line_size)) {
+    indexer_.reset();
+    return false;
+  }
+  const size_t num_lines = NumLines();
+  line_size_.Append(line_size.begin(), line_size.end());
+  NotifyLinesChanged(num_lines, 0, num_lines);
+  return true;
+}
+
+bool MonoBuffer::WaitForLine(size_t line) {
+  while (line >= NumLines() && WaitForIndex())
+    ;
+  return line < NumLines();
+}
+
+void MonoBuffer::WaitForOffset(size_t offset) {
+  while (indexer_ && IndexedPrefix() <= offset && WaitForIndex())
+    ;
+}
+
 void MonoBuffer::ComputePosition(size_t offset, size_t &line, size_t &col) {
   offset = std::min(buffer_.size(), offset);
+  WaitForOffset(offset);
   line = line_size_.LowerBound(offset);
   if (line == line_size_.size()) {
     col = 0;
@@ -93,6 +195,7 @@ void MonoBuffer::ComputePosition(size_t offset, size_t &line, size_t &col) {
 }
 
 void MonoBuffer::ComputeOffset(size_t line, size_t col, size_t &offset) {
+  WaitForLine(line);
   line = std::min(line, line_size_.size());
   col = line < line_size_.size()
             ? std::min(col, static_cast<decltype(col)>(line_size_.At(line)))
@@ -100,12 +203,73 @@ void MonoBuffer::ComputeOffset(size_t line, size_t col, size_t &offset) {
   offset = line_size_.GetPrefixSum(line - 1) + col;
 }
 
+MonoBuffer &MonoBuffer::Concat(MonoBuffer &&other) {
+  WaitForOffset(size());
+  other.WaitForOffset(other.size());
+  if (other.line_size_.empty())
+    return *this;
+  const size_t num_lines = NumLines();
+  size_t line = num_lines;
+  if (!buffer_.empty() && buffer_.At(buffer_.size() - 1) != kNewLine) {
+    // Merge our last line and the first line of other.
+    line_size_.Add(--line, other.line_size_.At(0));
+    other.line_size_.Remove(0);
+  }
+  buffer_.Concat(std::move(other.buffer_));
+  line_size_.Concat(std::move(other.line_size_));
+  for (auto &mapping : other.mappings_)
+    mappings_.emplace_back(std::move(mapping));
+  other.mappings_.clear();
+  NotifyLinesChanged(line, num_lines - line, num_lines);
+  return *this;
+}
+
+MonoBuffer &MonoBuffer::ParallelAppend(const char *data, size_t len,
+                                       const LoadOptions &options) {
+  const size_t num_threads = options.num_threads;
+  // Use more chunks than threads to balance load, chunks are aligned to
+  // piece size so that no partial piece is left in the middle of rope.
+  static constexpr size_t kAlign = 1UL << 12;
+  const size_t num_chunks = num_threads * 4;
+  const size_t chunk_size =
+      std::max(kAlign, (len / num_chunks + kAlign - 1) / kAlign * kAlign);
+  ThreadPool pool(num_threads);
+  std::vector<std::future<std::unique_ptr<MonoBuffer>>> parts;
+  for (size_t offset = 0; offset < len; offset += chunk_size) {
+    const size_t size = std::min(chunk_size, len - offset);
+    parts.emplace_back(pool.Submit([data, offset, size, &options] {
+      auto part = std::make_unique<MonoBuffer>();
+      part->Append(data + offset, size, options.mmap);
+      return part;
+    }));
+  }
+  for (auto &part : parts)
+    Concat(std::move(*part.get()));
+  return *this;
+}
+
 std::unique_ptr<MonoBuffer>
-MonoBuffer::CreateFromFile(const std::string &filename) {
+MonoBuffer::CreateFromFile(const std::string &filename,
+                           const LoadOptions &options) {
   auto buffer = std::make_unique<MonoBuffer>();
   auto membuf = MemoryBuffer::OpenIfExists(filename);
-  if (membuf)
-    buffer->Append(membuf->buffer(), membuf->length());
+  if (membuf && options.background_index) {
+    if (options.mmap)
+      buffer->buffer_.AppendView(membuf->buffer(), membuf->length());
+    else
+      buffer->buffer_.Append(membuf->buffer(), membuf->length());
+    buffer->indexer_ =
+        std::make_unique<LineIndexer>(membuf->buffer(), membuf->length());
+    buffer->mappings_.emplace_back(std::move(membuf));
+  } else if (membuf) {
+    if (options.num_threads > 1 &&
+        membuf->length() >= options.parallel_threshold)
+      buffer->ParallelAppend(membuf->buffer(), membuf->length(), options);
+    else
+      buffer->Append(membuf->buffer(), membuf->length(), options.mmap);
+    if (options.mmap)
+      buffer->mappings_.emplace_back(std::move(membuf));
+  }
   buffer->set_filename(filename);
   return buffer;
 }
@@ -124,10 +288,9 @@ size_t MonoBuffer::Erase(size_t offset, size_t len) {
   ComputePosition(offset, begin_line, begin_col);
   size_t end_line, end_col;
   ComputePosition(offset + len, end_line, end_col);
-  for (size_t complete_line = begin_line + 1; complete_line < end_line;
-       ++complete_line) {
-    line_size_.Remove(begin_line + 1);
-  }
+  const size_t num_lines = NumLines();
+  if (end_line > begin_line + 1)
+    line_size_.Erase(begin_line + 1, end_line - begin_line - 1);
   if (begin_line == end_line) {
     line_size_.Add(begin_line, -(end_col - begin_col));
   } else {
@@ -144,33 +307,36 @@ size_t MonoBuffer::Erase(size_t offset, size_t len) {
     assert(begin_line == line_size_.size() - 1);
     line_size_.Remove(begin_line);
   }
-  return buffer_.Erase(offset, len);
+  const size_t erased = buffer_.Erase(offset, len);
+  NotifyLinesChanged(begin_line,
+                     std::min(end_line + 1, num_lines) - begin_line,
+                     num_lines);
+  return erased;
 }
 
 size_t MonoBuffer::GetLine(size_t line, size_t limit, std::string &content) {
-  if (line >= line_size_.size())
+  if (!WaitForLine(line))
     return 0;
   size_t offset;
   ComputeOffset(line, 0, offset);
-  size_t i = offset;
-  for (; i < offset + std::min(limit, static_cast<decltype(limit)>(
-                                          line_size_.At(line)));
-       ++i) {
-    content.push_back(buffer_.At(i));
-  }
-  return i - offset;
+  const size_t len =
+      std::min(limit, static_cast<decltype(limit)>(line_size_.At(line)));
+  return Read(offset, len, content);
 }
 
 bool MonoBuffer::Verify() {
+  WaitForOffset(size());
   std::vector<long> stats;
   long current = 0;
-  for (size_t i = 0; i < buffer_.size(); ++i) {
-    ++current;
-    if (buffer_.At(i) == kNewLine) {
-      stats.push_back(current);
-      current = 0;
+  buffer_.Visit(0, size(), [&](const char *data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+      ++current;
+      if (data[i] == kNewLine) {
+        stats.push_back(current);
+        current = 0;
+      }
     }
-  }
+  });
   if (current)
     stats.push_back(current);
   if (abs_diff(stats.size(), line_size_.size()) != 0)
@@ -183,10 +349,23 @@ bool MonoBuffer::Verify() {
 }
 
 bool MonoBuffer::IsUTF8Encoded() {
-  uint32_t state = UTF8_ACCEPT, cp;
-  for (size_t i = 0; i < buffer_.size(); ++i)
-    DecodeUTF8(&state, &cp, buffer_.At(i));
-  return state == UTF8_ACCEPT;
+  UTF8Validator validator;
+  buffer_.Visit(0, size(), [&validator](const char *data, size_t len) {
+    validator.Feed(data, len);
+  });
+  return validator.ok();
+}
+
+bool MonoBuffer::SaveFile(const std::string &filename, SyncPolicy policy) {
+  // Views may refer to the file being saved, so the file is replaced rather
+  // than truncated.
+  AtomicFileWriter writer(filename, policy);
+  if (!writer.is_open())
+    return false;
+  buffer_.Visit(0, size(), [&writer](const char *data, size_t len) {
+    writer.Write(data, len);
+  });
+  return writer.Commit();
 }
 
 } // namespace emcc::editor
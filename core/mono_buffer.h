@@ -1,49 +1,101 @@
 #pragma once
 
+#include "core/line_indexer.h"
+#include "support/btree_rope.h"
+#include "support/file_writer.h"
 #include "support/prefix_sum.h"
 #include "support/rope.h"
+#include "support/sys.h"
 
+#include <functional>
+#include <iterator>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace emcc::editor {
 
+struct LoadOptions {
+  // Files not smaller than parallel_threshold are split into chunks and
+  // loaded by num_threads threads.
+  size_t num_threads = 1;
+  size_t parallel_threshold = 64UL << 20;
+  // Refer to the mmapped file rather than copying it into the buffer. Only
+  // edited pieces are copied.
+  bool mmap = false;
+  // Index lines on a background thread, so that leading lines are available
+  // before the whole file is scanned. num_threads is not used then.
+  bool background_index = false;
+};
+
 class MonoBuffer {
 public:
   static constexpr char kNewLine = '\n';
   static constexpr size_t npos = ~0UL;
+  // Called with (line, removed, inserted) after lines [line, line + removed)
+  // are replaced by inserted lines, including lines indexed in background.
+  using LinesChangedCallback = std::function<void(size_t, size_t, size_t)>;
   static std::unique_ptr<MonoBuffer>
-  CreateFromFile(const std::string &filename);
+  CreateFromFile(const std::string &filename,
+                 const LoadOptions &options = LoadOptions());
   MonoBuffer() {}
   size_t size() const { return buffer_.size(); }
   // Any value in line_size_ should not be zero.
+  // Lines being indexed in background are not counted.
   size_t NumLines() const { return line_size_.size(); }
+  // Take lines indexed in background so far. Returns true if all lines are
+  // indexed.
+  bool SyncIndex();
+  // Block until the line is indexed. Returns false if there is no such line.
+  bool WaitForLine(size_t line);
+  // Block until the byte at offset is indexed.
+  void WaitForOffset(size_t offset);
+  bool IsFullyIndexed() const { return !indexer_; }
+  // Number of bytes scanned by background indexer.
+  size_t IndexedSize() const {
+    return indexer_ ? indexer_->indexed() : buffer_.size();
+  }
   bool Get(size_t line, size_t col, char &c);
   bool Get(size_t offset, char &c);
   size_t GetLine(size_t line, size_t limit, std::string &content);
+  // Append [offset, offset + len) to out. Returns number of read bytes.
+  size_t Read(size_t offset, size_t len, std::string &out) const {
+    return buffer_.Read(offset, len, out);
+  }
+  size_t Read(size_t offset, size_t len, char *out) const {
+    return buffer_.Read(offset, len, out);
+  }
   MonoBuffer &Insert(size_t offset, char c);
+  // Splice text into the buffer, line sizes are updated in a single pass.
+  MonoBuffer &Insert(size_t offset, std::string_view text);
   MonoBuffer &Insert(size_t line, size_t column, char c);
   MonoBuffer &Append(size_t line, char c) { return Insert(line, ~0, c); }
   MonoBuffer &Append(const char *data, size_t len);
+  // Like Append, but data is referred rather than copied, so data must
+  // outlive the buffer.
+  MonoBuffer &AppendView(const char *data, size_t len);
   MonoBuffer &Append(char c);
   MonoBuffer &Concat(MonoBuffer &&other);
   MonoBuffer Split(size_t offset);
   size_t Erase(size_t offset, size_t len);
   size_t Erase(size_t line, size_t column, size_t len);
   size_t Erase(size_t line, size_t column, size_t len, MonoBuffer &erased);
-  bool SaveFile(const std::string &filename);
+  bool SaveFile(const std::string &filename,
+                SyncPolicy policy = SyncPolicy::kFull);
   void ComputePosition(size_t offset, size_t &line, size_t &col);
   void ComputeOffset(size_t line, size_t col, size_t &offset);
   void ComputePoint(size_t line, size_t col, size_t &point) {
     return ComputeOffset(line, col, point);
   }
   size_t GetLineSize(size_t line) {
+    WaitForLine(line);
     assert(line < line_size_.size());
     return line_size_.At(line);
   }
   // Sum of line size between [start, end].
   size_t GetLineSize(size_t start, size_t end) {
+    WaitForLine(end);
     if (line_size_.empty())
       return 0;
     end = std::min(end, line_size_.size() - 1);
@@ -52,17 +104,68 @@ public:
     }
     return line_size_.GetPrefixSum(end) - line_size_.GetPrefixSum(start - 1);
   }
+  // Append sizes of lines [begin, end) to sizes in a single pass, lines
+  // being indexed in background are not waited for.
+  void PeekLineSizes(size_t begin, size_t end,
+                     std::vector<long> &sizes) const {
+    line_size_.PeekRange(begin, end, std::back_inserter(sizes));
+  }
   bool Verify();
   void set_filename(const std::string &filename) { filename_ = filename; }
   const std::string &filename() const { return filename_; }
   bool IsUTF8Encoded();
+  // Returns an id to remove the callback.
+  size_t AddLinesChangedCallback(LinesChangedCallback callback) {
+    callbacks_.emplace_back(++last_callback_id_, std::move(callback));
+    return last_callback_id_;
+  }
+  void RemoveLinesChangedCallback(size_t id) {
+    for (auto it = callbacks_.begin(); it != callbacks_.end(); ++it) {
+      if (it->first == id) {
+        callbacks_.erase(it);
+        return;
+      }
+    }
+  }
 
 private:
-  using StorageTy = Rope<char, 1UL << 12>;
+#ifdef EMCC_BTREE_ROPE
+  // Faster random access, but mapped files are copied into leaves.
+  using StorageTy = BTreeRope<char>;
+#else
+  using StorageTy = Rope<char, 1UL << 12, PoolAllocator>;
+#endif
+
+  // Collect sizes of lines in data, the last line may not end with kNewLine.
+  static void ScanLines(const char *data, size_t len,
+                        std::vector<long> &line_size);
+  MonoBuffer &Append(const char *data, size_t len, bool view);
+  MonoBuffer &ParallelAppend(const char *data, size_t len,
+                             const LoadOptions &options);
+  // Take more lines from indexer_, blocks if none is ready. Returns false if
+  // all lines are indexed.
+  bool WaitForIndex();
+  // Size of data covered by line_size_.
+  size_t IndexedPrefix() {
+    return line_size_.empty() ? 0 : line_size_.GetPrefixSum(NumLines() - 1);
+  }
+  // removed lines from line were edited, num_lines is NumLines() before the
+  // edit.
+  void NotifyLinesChanged(size_t line, size_t removed, size_t num_lines) {
+    for (auto &callback : callbacks_)
+      callback.second(line, removed, removed + NumLines() - num_lines);
+  }
 
+  // Files referred by buffer_, must be destroyed after buffer_.
+  std::vector<std::unique_ptr<MemoryBuffer>> mappings_;
   StorageTy buffer_;
-  PrefixSum<long> line_size_;
+  PrefixSum<long, PoolAllocator> line_size_;
+  // Scans the tail of buffer_ not covered by line_size_ yet. It reads
+  // mappings_, so must be destroyed before them.
+  std::unique_ptr<LineIndexer> indexer_;
   std::string filename_;
+  std::vector<std::pair<size_t, LinesChangedCallback>> callbacks_;
+  size_t last_callback_id_ = 0;
 };
 
 } // namespace emcc::editor
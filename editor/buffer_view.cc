@@ -3,50 +3,109 @@
 namespace emcc::editor {
 
 void BufferView::Reset() {
-  total_height_ = 0;
-  lines_.clear();
+  DropLines(0, lines_.size());
   FillBufferView();
 }
 
+void BufferView::DropLines(size_t begin, size_t end) {
+  if (begin == end)
+    return;
+  if (cache_) {
+    for (size_t i = begin; i < end; ++i)
+      cache_->Put(baseline_ + i, std::move(lines_[i]));
+  }
+  lines_.erase(lines_.begin() + begin, lines_.begin() + end);
+  row_index_.Erase(begin, end - begin);
+}
+
 void BufferView::RePosition(size_t baseline) {
   if (baseline_ == baseline)
     return;
   if (baseline > baseline_ && baseline < baseline_ + lines_.size()) {
-    size_t gap = baseline - baseline_;
-    total_height_ = 0;
-    for (size_t i = 0; i < lines_.size() - gap; ++i) {
-      std::swap(lines_[i], lines_[i + gap]);
-      total_height_ += lines_[i].height();
+    DropLines(0, baseline - baseline_);
+  } else if (baseline < baseline_ && !lines_.empty() &&
+             baseline_ - baseline < height_hint_) {
+    const size_t gap = baseline_ - baseline;
+    for (size_t i = gap; i-- > 0;) {
+      // Only the last line may be laid out partially, a partial line here
+      // takes all rows, so lines after it are dropped by Shrink.
+      lines_.push_front(Layout(baseline + i, height_hint_));
+      row_index_.Insert(0, lines_.front().height());
     }
-    lines_.resize(lines_.size() - gap);
     baseline_ = baseline;
-    FillBufferView();
+    Shrink();
   } else {
-    baseline_ = baseline;
-    Reset();
+    DropLines(0, lines_.size());
   }
+  baseline_ = baseline;
+  FillBufferView();
+}
+
+void BufferView::Shrink() {
+  size_t n = lines_.size();
+  while (n > 1 && size_t(row_index_.PeekPrefixSum(n - 2)) >= height_hint_)
+    --n;
+  DropLines(n, lines_.size());
 }
 
 void BufferView::Resize(size_t h, size_t w) {
   height_hint_ = h;
   width_ = w;
-  total_height_ = 0;
-  for (size_t i = 0; i < lines_.size(); ++i) {
-    lines_[i].Resize(width_);
-    total_height_ += lines_[i].height();
+  // Lines only re-wrap their own chars, so long lines are re-wrapped in
+  // parallel while short ones are done here.
+  std::vector<std::future<void>> resized;
+  for (auto &lv : lines_) {
+    if (pool_ && lv.MemoryUsage() >= kParallelResizeBytes)
+      resized.push_back(pool_->Submit([&lv, w] { lv.Resize(w); }));
+    else
+      lv.Resize(w);
   }
+  for (auto &done : resized)
+    done.get();
+  std::vector<long> heights;
+  for (auto &lv : lines_)
+    heights.push_back(lv.height());
+  row_index_.clear();
+  row_index_.Append(heights.begin(), heights.end());
+  FillBufferView();
+}
+
+void BufferView::EditLine(size_t line, size_t offset, size_t removed,
+                          size_t inserted) {
+  if (line >= baseline_ + lines_.size())
+    return;
+  const long delta = long(inserted) - long(removed);
+  size_t i = line < baseline_ ? 0 : line - baseline_ + 1;
+  for (size_t j = i; j < lines_.size(); ++j)
+    lines_[j].Move(delta);
+  if (line < baseline_)
+    return;
+  LineView &lv = lines_[--i];
+  const long height = lv.height();
+  lv.Edit(offset, removed, inserted);
+  row_index_.Add(i, long(lv.height()) - height);
   FillBufferView();
 }
 
 void BufferView::FillBufferView() {
-  size_t current_line = baseline_ + lines_.size(),
-         total_lines = parent_->NumLines();
-  while (total_height_ < height_hint_ && current_line < total_lines) {
-    lines_.emplace_back(parent_, current_line++, width_);
-    // std::cout << lines_.back().height() << std::endl;
-    total_height_ += lines_.back().height();
+  size_t num_rows = NumRows();
+  // Lines are laid out only as far as rows are wanted, so only the last line
+  // may be laid out partially.
+  if (!lines_.empty() && !lines_.back().IsFullyLaidOut() &&
+      num_rows < height_hint_) {
+    LineView &lv = lines_.back();
+    const size_t height = lv.height();
+    lv.Extend(height + height_hint_ - num_rows);
+    row_index_.Add(lines_.size() - 1, long(lv.height()) - long(height));
+    num_rows += lv.height() - height;
+  }
+  size_t current_line = baseline_ + lines_.size();
+  // Lines may still be being indexed in background.
+  while (num_rows < height_hint_ && parent_->WaitForLine(current_line)) {
+    lines_.push_back(Layout(current_line++, height_hint_ - num_rows));
+    row_index_.Insert(lines_.size() - 1, lines_.back().height());
+    num_rows += lines_.back().height();
   }
-  // std::cout << total_height_ << std::endl;
 }
 
 void BufferView::Extend(size_t h) {
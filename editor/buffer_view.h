@@ -2,15 +2,26 @@
 
 #include "core/mono_buffer.h"
 #include "editor/char_view.h"
+#include "editor/layout_cache.h"
 #include "editor/line_view.h"
+#include "support/prefix_sum.h"
+#include "support/thread_pool.h"
+
+#include <deque>
+#include <optional>
+#include <utility>
 
 namespace emcc::editor {
 
 class BufferView {
 public:
-  explicit BufferView(MonoBuffer *parent, size_t h, size_t w)
+  // Lines leaving the view are kept in cache if it is given, and taken from
+  // it when they are viewed again. Long lines are re-wrapped on pool if it
+  // is given.
+  explicit BufferView(MonoBuffer *parent, size_t h, size_t w,
+                      LayoutCache *cache = nullptr, ThreadPool *pool = nullptr)
       : parent_(parent), height_hint_(h), width_(w), baseline_(0),
-        total_height_(0) {
+        cache_(cache), pool_(pool) {
     Reset();
   }
 
@@ -19,10 +30,16 @@ public:
   void RePosition(size_t baseline);
   void Resize(size_t h, size_t w);
   void Extend(size_t h);
+  // Bytes [offset, offset + removed) of line were replaced by inserted
+  // bytes, without adding or removing line breaks. The line is laid out
+  // again incrementally if it is in the view.
+  void EditLine(size_t line, size_t offset, size_t removed, size_t inserted);
 
   size_t NumLines() const { return lines_.size(); }
 
-  size_t NumRows() const { return total_height_; }
+  size_t NumRows() const {
+    return row_index_.empty() ? 0 : row_index_.PeekPrefixSum(lines_.size() - 1);
+  }
 
   class row_iterator {
   public:
@@ -65,52 +82,61 @@ public:
     return it;
   }
 
-  // FIXME: Use fenwick tree to accelerate query.
   std::optional<emcc::iterator_range<LineView::iterator>> GetRow(size_t row) {
-    size_t lineno = 0, segno = 0, num_rows = 0;
-    for (; lineno < lines_.size(); ++lineno) {
-      auto &lv = lines_[lineno];
-      size_t s = num_rows;
-      num_rows += lv.height();
-      if (num_rows > row) {
-        segno = row - s;
-        break;
-      }
-    }
-    if (lineno == lines_.size())
+    auto pos = Locate(row);
+    if (!pos)
       return std::nullopt;
-    return lines_[lineno].GetSegment(segno);
+    return lines_[pos->first].GetSegment(pos->second);
   }
 
   emcc::iterator_range<row_iterator> row_range(size_t begin, size_t end) {
     assert(end >= begin);
-    row_iterator b(*this), e(*this);
-    e.lineno_ = lines_.size();
-    size_t lineno = 0, num_rows = 0;
-    for (; lineno < lines_.size(); ++lineno) {
-      auto &lv = lines_[lineno];
-      size_t s = num_rows;
-      num_rows += lv.height();
-      if (num_rows > begin) {
-        b.lineno_ = lineno;
-        b.segno_ = begin - s;
-      }
-      if (num_rows > end) {
-        e.lineno_ = lineno;
-        e.segno_ = end - s;
-        break;
-      }
+    row_iterator b(row_end()), e(row_end());
+    if (auto pos = Locate(begin)) {
+      b.lineno_ = pos->first;
+      b.segno_ = pos->second;
+    }
+    if (auto pos = Locate(end)) {
+      e.lineno_ = pos->first;
+      e.segno_ = pos->second;
     }
     return emcc::make_range(b, e);
   }
 
 private:
   friend class row_iterator;
+  // Layouts taking at least this many bytes are re-wrapped on pool_.
+  static constexpr size_t kParallelResizeBytes = 1UL << 16;
+
   void FillBufferView();
+  // Lay out line with at least rows segments.
+  LineView Layout(size_t line, size_t rows) {
+    return cache_ ? cache_->Get(line, width_, rows)
+                  : LineView(parent_, line, width_, rows);
+  }
+  // Drop lines_[begin, end), keeping their layouts in cache_.
+  void DropLines(size_t begin, size_t end);
+  // Drop lines after the first one past height_hint_ rows.
+  void Shrink();
+  // Line and segment of row, in O(log n).
+  std::optional<std::pair<size_t, size_t>> Locate(size_t row) const {
+    const size_t lineno = row_index_.UpperBound(row);
+    if (lineno >= lines_.size())
+      return std::nullopt;
+    return std::make_pair(lineno,
+                          row - (lineno ? row_index_.PeekPrefixSum(lineno - 1)
+                                        : 0));
+  }
 
   MonoBuffer *parent_;
-  size_t height_hint_, width_, baseline_, total_height_;
-  std::vector<LineView> lines_;
+  size_t height_hint_, width_, baseline_;
+  LayoutCache *cache_;
+  ThreadPool *pool_;
+  // Lines from baseline_. Lines scrolled into view are laid out at either
+  // end, lines still in view are kept.
+  std::deque<LineView> lines_;
+  // Heights of lines_.
+  PrefixSum<long> row_index_;
 };
 
 } // namespace emcc::editor
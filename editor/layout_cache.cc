@@ -0,0 +1,85 @@
+#include "editor/layout_cache.h"
+
+#include <vector>
+
+namespace emcc::editor {
+
+LayoutCache::LayoutCache(MonoBuffer *buffer, size_t budget)
+    : buffer_(buffer),
+      callback_id_(buffer->AddLinesChangedCallback(
+          [this](size_t line, size_t removed, size_t inserted) {
+            OnLinesChanged(line, removed, inserted);
+          })),
+      budget_(budget) {}
+
+LayoutCache::~LayoutCache() {
+  buffer_->RemoveLinesChangedCallback(callback_id_);
+}
+
+LineView LayoutCache::Get(size_t line, size_t width, size_t rows) {
+  auto it = index_.find({line, width});
+  if (it == index_.end()) {
+    ++misses_;
+    return LineView(buffer_, line, width, rows);
+  }
+  ++hits_;
+  LineView lv = std::move(it->second->lv);
+  Erase(it->second);
+  // Lines before it may have been edited.
+  size_t point;
+  buffer_->ComputePoint(line, 0, point);
+  lv.Move(long(point) - long(lv.point()));
+  lv.Extend(rows);
+  return lv;
+}
+
+void LayoutCache::Put(size_t line, LineView &&lv) {
+  const Key key(line, lv.width());
+  if (auto it = index_.find(key); it != index_.end())
+    Erase(it->second);
+  const size_t memory_usage = lv.MemoryUsage() + sizeof(Entry);
+  entries_.push_front({key, std::move(lv), memory_usage});
+  index_.emplace(key, entries_.begin());
+  memory_usage_ += memory_usage;
+  Evict();
+}
+
+void LayoutCache::clear() {
+  entries_.clear();
+  index_.clear();
+  memory_usage_ = 0;
+}
+
+void LayoutCache::Erase(EntryList::iterator it) {
+  memory_usage_ -= it->memory_usage;
+  index_.erase(it->key);
+  entries_.erase(it);
+}
+
+void LayoutCache::Evict() {
+  while (memory_usage_ > budget_)
+    Erase(std::prev(entries_.end()));
+}
+
+void LayoutCache::OnLinesChanged(size_t line, size_t removed,
+                                 size_t inserted) {
+  auto it = index_.lower_bound({line, 0});
+  while (it != index_.end() && it->first.first < line + removed) {
+    auto entry = it++->second;
+    Erase(entry);
+  }
+  if (removed == inserted)
+    return;
+  // Keys of later lines are shifted after all of them are taken out, so that
+  // they do not collide with keys not shifted yet.
+  std::vector<decltype(index_)::node_type> nodes;
+  while (it != index_.end())
+    nodes.push_back(index_.extract(it++));
+  for (auto &node : nodes) {
+    node.key().first += inserted - removed;
+    node.mapped()->key = node.key();
+    index_.insert(std::move(node));
+  }
+}
+
+} // namespace emcc::editor
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "core/mono_buffer.h"
+#include "editor/line_view.h"
+
+#include <list>
+#include <map>
+#include <utility>
+
+namespace emcc::editor {
+
+// Layouts of lines no longer in view, so that lines viewed again are not
+// decoded and wrapped again. Layouts are keyed by line and width. Edits of
+// the buffer drop layouts of the edited lines and renumber lines after them.
+// Least recently used layouts are evicted once they take more bytes than the
+// budget.
+class LayoutCache {
+public:
+  LayoutCache(MonoBuffer *buffer, size_t budget);
+  LayoutCache(const LayoutCache &) = delete;
+  ~LayoutCache();
+
+  // Layout of line at width with at least rows segments. A cached layout is
+  // taken out of the cache, and laid out further if it is partial.
+  LineView Get(size_t line, size_t width, size_t rows = LineView::npos);
+  // Keep the layout of line, replacing the one of the same width.
+  void Put(size_t line, LineView &&lv);
+
+  size_t budget() const { return budget_; }
+  void set_budget(size_t budget) {
+    budget_ = budget;
+    Evict();
+  }
+  // Bytes taken by cached layouts.
+  size_t MemoryUsage() const { return memory_usage_; }
+  size_t size() const { return entries_.size(); }
+  void clear();
+
+  // Counters of Get, for tuning the budget.
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+
+private:
+  // Line and width.
+  using Key = std::pair<size_t, size_t>;
+  struct Entry {
+    Key key;
+    LineView lv;
+    size_t memory_usage;
+  };
+  using EntryList = std::list<Entry>;
+
+  void OnLinesChanged(size_t line, size_t removed, size_t inserted);
+  void Erase(EntryList::iterator it);
+  void Evict();
+
+  MonoBuffer *const buffer_;
+  const size_t callback_id_;
+  size_t budget_, memory_usage_ = 0;
+  size_t hits_ = 0, misses_ = 0;
+  // Most recently used first.
+  EntryList entries_;
+  std::map<Key, EntryList::iterator> index_;
+};
+
+} // namespace emcc::editor
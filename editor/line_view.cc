@@ -1,59 +1,276 @@
 #include "editor/line_view.h"
+#include "support/utf8_scan.h"
 
 namespace emcc::editor {
 
-void LineView::Reset(size_t lineno) {
+void LineView::Reset(size_t lineno, size_t rows) {
   segment_index_.clear();
-  hlist_.clear();
-  size_t point;
-  parent_->ComputePoint(lineno, 0, point);
-  UTF8Decoder utf8dec;
-  for (size_t rune_point = point; point < parent_->size(); ++point) {
-    char ch;
-    parent_->Get(point, ch);
-    if (utf8dec.Decode(ch)) {
-      hlist_.emplace_back(CreateCharView(rune_point, utf8dec.codepoint()));
-      // See https://tools.ietf.org/html/rfc3629
-      // > In UTF-8, characters from the U+0000..U+10FFFF range (the UTF-16
-      // > accessible range) are encoded using sequences of 1 to 4 octets.
-      assert((point + 1) - rune_point <= 4);
-      rune_point = point + 1;
+  chunks_.clear();
+  bytes_.clear();
+  num_chars_ = 0;
+  parent_->ComputePoint(lineno, 0, start_);
+  size_ = parent_->WaitForLine(lineno) ? parent_->GetLineSize(lineno) : 0;
+  laid_out_ = size_ == 0;
+  Extend(rows);
+}
+
+void LineView::Extend(size_t rows) {
+  if (laid_out_ || height() >= rows)
+    return;
+  // Assume two bytes per column. Pieces grow, so that a segment of many
+  // zero width chars is not wrapped again for every piece.
+  const size_t wanted = rows - height();
+  size_t piece = wanted >= size_ / width_
+                     ? size_
+                     : std::max(kMinPiece, wanted * width_ * 2);
+  while (!laid_out_ && height() < rows) {
+    const size_t begin = bytes_.size();
+    size_t end = std::min(size_, begin + piece);
+    Reserve(end);
+    bytes_.resize(end);
+    parent_->Read(start_ + begin, end - begin, bytes_.data() + begin);
+    // The rune cut at the end is read again by the next piece.
+    if (end < size_) {
+      end = ResumePoint(bytes_.data(), end);
+      bytes_.resize(end);
+    }
+    size_t n;
+    const bool valid = Index(num_chars_, begin, end, chunks_, n);
+    num_chars_ += n;
+    laid_out_ = !valid || end == size_;
+    ReCompute(segment_index_.empty() ? 0 : segment_index_.size() - 1);
+    piece *= 2;
+  }
+}
+
+void LineView::Truncate(size_t offset) {
+  const size_t chunk =
+      std::lower_bound(chunks_.begin(), chunks_.end(), offset,
+                       [](const Chunk &chunk, size_t offset) {
+                         return chunk.offset < offset;
+                       }) -
+      chunks_.begin();
+  if (chunk == 0) {
+    bytes_.clear();
+    chunks_.clear();
+    num_chars_ = 0;
+  } else {
+    bytes_.resize(chunks_[chunk - 1].offset);
+    num_chars_ = chunks_[chunk - 1].first;
+    chunks_.resize(chunk - 1);
+  }
+  // The segment holding the last kept char is wrapped again.
+  while (!segment_index_.empty() && segment_index_.back().first >= num_chars_)
+    segment_index_.pop_back();
+  laid_out_ = false;
+}
+
+size_t LineView::Locate(size_t offset, size_t &char_offset) const {
+  // The last chunk starting at or before offset.
+  size_t chunk = std::upper_bound(chunks_.begin(), chunks_.end(), offset,
+                                  [](size_t offset, const Chunk &chunk) {
+                                    return offset < chunk.offset;
+                                  }) -
+                 chunks_.begin();
+  if (chunk == 0) {
+    char_offset = num_chars_ ? chunks_[0].offset : bytes_.size();
+    return 0;
+  }
+  --chunk;
+  const size_t end =
+      chunk + 1 < chunks_.size() ? chunks_[chunk + 1].first : num_chars_;
+  size_t index = chunks_[chunk].first;
+  char_offset = chunks_[chunk].offset;
+  CharView cv;
+  while (index < end && char_offset < offset) {
+    char_offset += DecodeAt(char_offset, cv);
+    ++index;
+  }
+  if (index == end && chunk + 1 < chunks_.size())
+    char_offset = chunks_[chunk + 1].offset;
+  else if (index == num_chars_)
+    char_offset = bytes_.size();
+  return index;
+}
+
+bool LineView::Index(size_t first, size_t begin, size_t end,
+                     std::vector<Chunk> &chunks, size_t &n) const {
+  n = 0;
+  return DecodeUTF8(bytes_.data() + begin, end - begin,
+                    [&](size_t i, uint32_t codepoint) {
+                      if (n % kChunkSize == 0)
+                        chunks.push_back({first + n, begin + i, 1});
+                      // '\n' is shown as one column, see CreateCharView.
+                      if (codepoint >= 0x80 ||
+                          (codepoint != '\n' && wchar_width(codepoint) != 1))
+                        chunks.back().ascii = 0;
+                      ++n;
+                    });
+}
+
+void LineView::Replace(size_t offset, size_t removed, size_t inserted) {
+  if (inserted > removed) {
+    Reserve(bytes_.size() + inserted - removed);
+    bytes_.insert(bytes_.begin() + offset + removed, inserted - removed, 0);
+  } else {
+    bytes_.erase(bytes_.begin() + offset + inserted,
+                 bytes_.begin() + offset + removed);
+  }
+  parent_->Read(start_ + offset, inserted, bytes_.data() + offset);
+}
+
+void LineView::Edit(size_t offset, size_t removed, size_t inserted) {
+  const long shift = long(inserted) - long(removed);
+  if (!laid_out_ && offset + removed > bytes_.size()) {
+    // The edit reaches past the laid out prefix, lay out from it again.
+    const size_t rows = height();
+    if (offset < bytes_.size())
+      Truncate(offset);
+    size_ += shift;
+    Extend(rows);
+    return;
+  }
+  if (segment_index_.empty()) {
+    Replace(offset, removed, inserted);
+    size_ += shift;
+    chunks_.clear();
+    Index(0, 0, bytes_.size(), chunks_, num_chars_);
+    ReCompute(0);
+    return;
+  }
+  const size_t begin = offset, end = begin + removed;
+  // Chars overlapping [begin, end) are decoded again.
+  size_t first_offset, last_offset;
+  size_t first = Locate(begin, first_offset);
+  if (first > 0 && (first == num_chars_ || first_offset > begin))
+    --first;
+  const size_t last = Locate(end, last_offset);
+  Replace(offset, removed, inserted);
+  size_ += shift;
+  // Whole chunks holding [first, last) are indexed again, chunks after them
+  // are shifted.
+  const size_t c0 = FindChunk(first);
+  const size_t c1 =
+      std::lower_bound(chunks_.begin(), chunks_.end(), last,
+                       [](const Chunk &chunk, size_t index) {
+                         return chunk.first < index;
+                       }) -
+      chunks_.begin();
+  const size_t region_first = chunks_[c0].first;
+  const size_t region_end =
+      c1 < chunks_.size() ? chunks_[c1].offset + shift : bytes_.size();
+  std::vector<Chunk> chunks;
+  size_t n;
+  Index(region_first, chunks_[c0].offset, region_end, chunks, n);
+  const size_t old_n =
+      (c1 < chunks_.size() ? chunks_[c1].first : num_chars_) - region_first;
+  const long delta = long(n) - long(old_n);
+  for (size_t c = c1; c < chunks_.size(); ++c) {
+    chunks_[c].first += delta;
+    chunks_[c].offset += shift;
+  }
+  chunks_.erase(chunks_.begin() + c0, chunks_.begin() + c1);
+  chunks_.insert(chunks_.begin() + c0, chunks.begin(), chunks.end());
+  num_chars_ += delta;
+  // The break before a char depends on the char itself, so re-wrap from the
+  // segment of the char before the edit.
+  const size_t seg =
+      std::upper_bound(segment_index_.begin(), segment_index_.end(),
+                       first > 0 ? first - 1 : 0,
+                       [](size_t index, const Segment &segment) {
+                         return index < segment.first;
+                       }) -
+      segment_index_.begin() - 1;
+  ReWrap(seg, first, last, delta, shift);
+}
+
+bool LineView::NextBreak(iterator &it, size_t &current_offset) const {
+  while (it.index_ < num_chars_) {
+    const size_t chunk = it.chunk_;
+    if (chunks_[chunk].ascii) {
+      // Every char takes one column, so chars fit as long as there is room.
+      const size_t end =
+          chunk + 1 < chunks_.size() ? chunks_[chunk + 1].first : num_chars_;
+      const size_t left = end - it.index_;
+      const size_t room = width_ > current_offset ? width_ - current_offset : 0;
+      const size_t n = std::min(left, room);
+      it.Forward(n, n);
+      current_offset += n;
+      if (n < left) {
+        current_offset = 1;
+        return true;
+      }
+      continue;
+    }
+    size_t hlen = (*it).length();
+    size_t s = current_offset + hlen;
+    size_t fill_current_segment_badness = s > width_ ? ~0 : abs_diff(s, width_);
+    size_t fill_next_segment_badness = abs_diff(hlen, width_);
+    if (fill_current_segment_badness > fill_next_segment_badness) {
+      current_offset = hlen;
+      return true;
     }
-    if (ch == editor::MonoBuffer::kNewLine)
+    current_offset = s;
+    ++it;
+  }
+  return false;
+}
+
+void LineView::ReWrap(size_t seg, size_t first, size_t last, long delta,
+                      long shift) {
+  // New segment starts after the start of seg.
+  std::vector<Segment> breaks;
+  // Old breaks from k may still be valid.
+  size_t k = seg + 1;
+  bool synced = false;
+  size_t current_offset = 0;
+  iterator it(*this, segment_index_[seg].first, segment_index_[seg].offset);
+  for (; NextBreak(it, current_offset); ++it) {
+    const size_t j = it.index_;
+    // Wrapping after an old break past the edit goes the same way as before.
+    while (k < segment_index_.size() &&
+           (segment_index_[k].first < last ||
+            segment_index_[k].first + delta < j))
+      ++k;
+    if (j >= first && k < segment_index_.size() &&
+        segment_index_[k].first + delta == j) {
+      synced = true;
       break;
+    }
+    breaks.push_back({j, it.offset_});
   }
-  ReCompute(0);
+  if (!synced)
+    k = segment_index_.size();
+  for (size_t m = k; m < segment_index_.size(); ++m) {
+    segment_index_[m].first += delta;
+    segment_index_[m].offset += shift;
+  }
+  segment_index_.erase(segment_index_.begin() + seg + 1,
+                       segment_index_.begin() + k);
+  segment_index_.insert(segment_index_.begin() + seg + 1, breaks.begin(),
+                        breaks.end());
+  // The first segment may have lost all of its chars.
+  if (segment_index_[seg].first >= num_chars_)
+    segment_index_.erase(segment_index_.begin() + seg);
 }
 
 void LineView::ReCompute(size_t seg) {
   seg = segment_index_.empty() ? 0 : std::min(seg, segment_index_.size() - 1);
-  size_t start_from = 0;
+  Segment start_from = {0, 0};
   if (!segment_index_.empty()) {
     start_from = segment_index_[seg];
   }
   segment_index_.resize(seg);
-  size_t i = start_from, j = i, current_offset = 0;
-  for (; j < hlist_.size(); ++j) {
-    auto &cv = hlist_.at(j);
-    // std::cout << cv.rune << " " << cv.length() << std::endl;
-    size_t hlen = cv.length();
-    size_t s = current_offset + hlen;
-    size_t fill_current_segment_badness = s > width_ ? ~0 : abs_diff(s, width_);
-    size_t fill_next_segment_badness = abs_diff(hlen, width_);
-    if (fill_current_segment_badness <= fill_next_segment_badness) {
-      current_offset = s;
-    } else {
-      // std::cout << "Break at: " << i << std::endl;
-      current_offset = hlen;
-      segment_index_.emplace_back(i);
-      i = j;
-    }
-    // std::cout << "current offset: " << current_offset << std::endl;
-    // std::cout << "current segment size: " << segment_index_.size() <<
-    // std::endl;
+  if (start_from.first >= num_chars_)
+    return;
+  Segment i = start_from;
+  size_t current_offset = 0;
+  for (iterator it(*this, start_from.first, start_from.offset);
+       NextBreak(it, current_offset); ++it) {
+    segment_index_.push_back(i);
+    i = {it.index_, it.offset_};
   }
-  if (i != j)
-    segment_index_.emplace_back(i);
+  segment_index_.push_back(i);
 }
 
 } // namespace emcc::editor
@@ -6,105 +6,228 @@
 #include "support/utf8.h"
 #include "support/wcwidth.h"
 
+#include <algorithm>
 #include <stddef.h>
 #include <stdint.h>
+#include <vector>
 
 namespace emcc::editor {
 
-// Break a logical line in MonoBuffer into segments.
+// Break a logical line in MonoBuffer into segments. A line may be laid out
+// partially, only its leading segments are decoded and wrapped, and more are
+// laid out on demand by Extend.
 class LineView {
 public:
+  static constexpr size_t npos = ~0UL;
+
   LineView() = default;
-  LineView(MonoBuffer *parent, size_t lineno, size_t width)
-      : width_(width), parent_(parent) {
-    Reset(lineno);
+  LineView(MonoBuffer *parent, size_t lineno, size_t width,
+           size_t rows = npos)
+      : width_(std::max<size_t>(width, 1)), parent_(parent) {
+    Reset(lineno, rows);
   }
 
-  void Reset(size_t lineno);
-  size_t height() const { return segment_index_.size(); }
-
-  void Resize(size_t width) {
-    width_ = width;
-    ReCompute(0);
+  // Lay out at least rows segments of the line, or all of it if it is
+  // shorter.
+  void Reset(size_t lineno, size_t rows = npos);
+  // Lay out more of the line until there are at least rows segments.
+  void Extend(size_t rows);
+  bool IsFullyLaidOut() const { return laid_out_; }
+  // Bytes [offset, offset + removed) of the line were replaced by inserted
+  // bytes, offset is relative to the start of the line. Only edited chars
+  // are decoded again, and segments are re-wrapped until breaks line up with
+  // the old ones. The edit must not add or remove line breaks.
+  void Edit(size_t offset, size_t removed, size_t inserted);
+  // Number of laid out segments. The last segment of a partial layout is
+  // not counted, since chars after it may still be put into it.
+  size_t height() const {
+    return laid_out_ || segment_index_.empty() ? segment_index_.size()
+                                               : segment_index_.size() - 1;
   }
 
-  template <typename... Args>
-  void Insert(int y, int x, Args &&...args) {
-    if (segment_index_.empty()) {
-      Append(std::forward<Args>(args)...);
-      return;
-    }
-    y = std::min((size_t)y, segment_index_.size() - 1);
-    x = std::min((size_t)x, NumCharViews(y));
-    size_t i = segment_index_[y] + x;
-    hlist_.emplace(hlist_.begin() + i, std::forward<Args>(args)...);
-    ReCompute(y);
-  }
+  size_t width() const { return width_; }
+  // Point of the start of the line.
+  size_t point() const { return start_; }
+  // The line was moved by delta bytes, by edits of lines before it.
+  void Move(long delta) { start_ += delta; }
 
-  template <typename... Args>
-  void Append(Args &&...args) {
-    hlist_.emplace_back(std::forward<Args>(args)...);
-    if (segment_index_.empty())
-      ReCompute(0);
-    else
-      ReCompute(segment_index_.size() - 1);
+  // A width of 0 is taken as 1.
+  void Resize(size_t width) {
+    width_ = std::max<size_t>(width, 1);
+    ReCompute(0);
   }
 
   size_t NumCharViews(size_t seg) const {
-    if (seg >= segment_index_.size())
+    if (seg >= height())
       return 0;
     if (seg == segment_index_.size() - 1)
-      return hlist_.size() - segment_index_[seg];
-    return segment_index_[seg + 1] - segment_index_[seg];
+      return num_chars_ - segment_index_[seg].first;
+    return segment_index_[seg + 1].first - segment_index_[seg].first;
+  }
+
+  // Bytes taken by the layout, chars are decoded when iterated.
+  size_t MemoryUsage() const {
+    return bytes_.capacity() + chunks_.capacity() * sizeof(Chunk) +
+           segment_index_.capacity() * sizeof(Segment);
   }
 
   class iterator {
   public:
     friend class LineView;
     iterator &operator++() {
-      ++index_;
+      Forward(1, length_);
       return *this;
     }
     bool operator==(const iterator &other) const {
-      return &parent_ == &other.parent_ && index_ == other.index_;
+      return parent_ == other.parent_ && index_ == other.index_;
     }
     bool operator!=(const iterator &other) const { return !(*this == other); }
 
-    CharView &operator*() { return parent_.hlist_.at(index_); }
+    // Refers to a copy held by the iterator, valid until it is advanced.
+    CharView &operator*() { return cv_; }
 
   private:
-    iterator(LineView &parent, size_t index) : index_(index), parent_(parent) {}
+    // Only the index of an end iterator is needed.
+    iterator(const LineView &parent, size_t index)
+        : parent_(&parent), index_(index) {}
+
+    // Char index starts at offset of bytes_.
+    iterator(const LineView &parent, size_t index, size_t offset)
+        : parent_(&parent), index_(index), offset_(offset) {
+      if (index_ >= parent_->num_chars_)
+        return;
+      chunk_ = parent_->FindChunk(index_);
+      length_ = parent_->DecodeAt(offset_, cv_);
+    }
 
-    size_t index_;
-    LineView &parent_;
+    // Skip chars taking bytes, which must not go past the current chunk.
+    void Forward(size_t chars, size_t bytes) {
+      index_ += chars;
+      offset_ += bytes;
+      if (index_ >= parent_->num_chars_)
+        return;
+      auto &chunks = parent_->chunks_;
+      if (chunk_ + 1 < chunks.size() && chunks[chunk_ + 1].first == index_)
+        offset_ = chunks[++chunk_].offset;
+      length_ = parent_->DecodeAt(offset_, cv_);
+    }
+
+    const LineView *parent_;
+    size_t index_, chunk_ = 0, offset_ = 0, length_ = 0;
+    CharView cv_ = {};
   };
 
   emcc::iterator_range<iterator> GetSegment(size_t seg) {
-    if (seg >= segment_index_.size())
+    if (seg >= height())
       return emcc::make_range(iterator(*this, 0), iterator(*this, 0));
+    iterator begin(*this, segment_index_[seg].first,
+                   segment_index_[seg].offset);
     if (seg == segment_index_.size() - 1)
-      return emcc::make_range(iterator(*this, segment_index_[seg]),
-                              iterator(*this, hlist_.size()));
-    return emcc::make_range(iterator(*this, segment_index_[seg]),
-                            iterator(*this, segment_index_[seg + 1]));
+      return emcc::make_range(begin, iterator(*this, num_chars_));
+    return emcc::make_range(begin,
+                            iterator(*this, segment_index_[seg + 1].first));
   }
 
 private:
-  CharView CreateCharView(size_t point, wchar_t wch) {
+  // Chars [first, next chunk's first) take bytes from offset of bytes_.
+  struct Chunk {
+    size_t first;
+    size_t offset : 63;
+    // Every char is a single byte taking one column, so char first + i is at
+    // offset + i.
+    size_t ascii : 1;
+  };
+  static constexpr size_t kChunkSize = 128;
+  // Partial layouts read at least this many bytes at a time, chars past the
+  // requested rows are wrapped too and make a margin for scrolling.
+  static constexpr size_t kMinPiece = 1UL << 12;
+
+  CharView CreateCharView(size_t point, wchar_t wch) const {
     CharView cv;
     cv.point = point;
     cv.rune = wch;
-    cv.width = wch == '\n' ? 1 : wchar_width(wch);
+    cv.width =
+        wch == '\n' || (wch >= 0x20 && wch < 0x7f) ? 1 : wchar_width(wch);
     return cv;
   }
 
+  // Indexed chars are valid UTF-8, so the lead byte tells the size.
+  static size_t RuneSize(uint8_t lead) {
+    return lead < 0x80 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+  }
+
+  // Decode the char at offset of bytes_, returns its size in bytes.
+  size_t DecodeAt(size_t offset, CharView &cv) const {
+    const uint8_t lead = bytes_[offset];
+    const size_t size = RuneSize(lead);
+    uint32_t codepoint = size == 1 ? lead : lead & (0x7F >> size);
+    for (size_t i = 1; i < size; ++i)
+      codepoint = (codepoint << 6) | (bytes_[offset + i] & 0x3F);
+    cv = CreateCharView(start_ + offset, codepoint);
+    return size;
+  }
+  size_t FindChunk(size_t index) const {
+    // Segments are mostly visited in order, try the last found chunk and
+    // the one after it first.
+    for (size_t c = last_chunk_; c < last_chunk_ + 2 && c < chunks_.size();
+         ++c) {
+      if (chunks_[c].first <= index &&
+          (c + 1 == chunks_.size() || index < chunks_[c + 1].first))
+        return c;
+    }
+    last_chunk_ = std::upper_bound(chunks_.begin(), chunks_.end(), index,
+                                   [](size_t index, const Chunk &chunk) {
+                                     return index < chunk.first;
+                                   }) -
+                  chunks_.begin() - 1;
+    return last_chunk_;
+  }
+  // Index of the first char at or after offset, its offset is set to
+  // char_offset, or end of bytes_ if there is no such char.
+  size_t Locate(size_t offset, size_t &char_offset) const;
+  // Grow bytes_ by a fraction rather than doubling, since a line may take
+  // hundreds of MBs.
+  void Reserve(size_t size) {
+    if (size > bytes_.capacity())
+      bytes_.reserve(size + size / 8);
+  }
+  // Splice bytes of an edit into bytes_.
+  void Replace(size_t offset, size_t removed, size_t inserted);
+  // Decode bytes_[begin, end) and append chunks of its chars, numbered from
+  // first, n is set to number of decoded chars. Returns false if an invalid
+  // byte stops decoding.
+  bool Index(size_t first, size_t begin, size_t end,
+             std::vector<Chunk> &chunks, size_t &n) const;
+  // Drop the layout from the chunk holding the byte before offset, so that
+  // bytes from offset may be laid out again.
+  void Truncate(size_t offset);
+  // Move it to the next char starting a segment, current_offset is the
+  // width of the segment so far. Returns false if there is no such char.
+  bool NextBreak(iterator &it, size_t &current_offset) const;
   void ReCompute(size_t seg);
+  // Re-wrap from segment seg after chars [first, last) were replaced, which
+  // shifted chars after them by delta, and their bytes by shift.
+  void ReWrap(size_t seg, size_t first, size_t last, long delta, long shift);
 
   size_t width_;
   MonoBuffer *parent_;
-  // Horizontal list, concept borrowed from TeX.
-  std::vector<CharView> hlist_;
-  std::vector<size_t> segment_index_;
+  // Point and size of the line.
+  size_t start_, size_;
+  // Whether the whole line is laid out. Otherwise bytes_ holds a prefix of
+  // the line ending at a rune boundary.
+  bool laid_out_ = true;
+  // Horizontal list, concept borrowed from TeX. Chars are kept as bytes of
+  // the line, which is several times smaller than a CharView per char.
+  std::vector<char> bytes_;
+  std::vector<Chunk> chunks_;
+  size_t num_chars_ = 0;
+  mutable size_t last_chunk_ = 0;
+  // Segments start from char first, at offset of bytes_, so that chunks are
+  // not decoded to find them.
+  struct Segment {
+    size_t first, offset;
+  };
+  std::vector<Segment> segment_index_;
 };
 
 } // namespace emcc::editor
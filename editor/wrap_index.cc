@@ -0,0 +1,241 @@
+#include "editor/wrap_index.h"
+#include "editor/line_view.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <string>
+
+namespace emcc::editor {
+
+WrapIndex::WrapIndex(MonoBuffer *buffer, size_t width, ThreadPool *pool)
+    : buffer_(buffer), width_(std::max<size_t>(width, 1)),
+      callback_id_(buffer->AddLinesChangedCallback(
+          [this](size_t line, size_t removed, size_t inserted) {
+            OnLinesChanged(line, removed, inserted);
+          })),
+      num_laid_out_(0), next_line_(0), pool_(pool) {
+  // Sizes are read in a single pass, GetLineSize would splay every line.
+  std::vector<long> heights;
+  buffer_->PeekLineSizes(0, buffer_->NumLines(), heights);
+  for (long &height : heights)
+    height = Estimate(height);
+  heights_.Append(heights.begin(), heights.end());
+  laid_out_.assign(heights.size(), false);
+  estimated_.assign(heights.size(), true);
+  num_estimated_ = heights.size();
+}
+
+WrapIndex::~WrapIndex() { buffer_->RemoveLinesChangedCallback(callback_id_); }
+
+void WrapIndex::Resize(size_t width) {
+  // A terminal may report no columns.
+  width_ = std::max<size_t>(width, 1);
+  // Estimating all lines takes about a second for ten million lines, so it
+  // is left to Refine and Sync, and the next frame waits only for lines in
+  // view.
+  laid_out_.assign(laid_out_.size(), false);
+  estimated_.assign(estimated_.size(), false);
+  num_laid_out_ = 0;
+  num_estimated_ = 0;
+  next_line_ = 0;
+  next_estimate_ = 0;
+  batches_.clear();
+  next_batch_ = 0;
+}
+
+long WrapIndex::Estimate(size_t size) const {
+  // Assume one column per byte.
+  return std::max(1UL, (size + width_ - 1) / width_);
+}
+
+size_t WrapIndex::EstimateLines(size_t max_lines) {
+  const size_t num_lines = estimated_.size();
+  if (num_estimated_ == num_lines)
+    return 0;
+  while (true) {
+    if (next_estimate_ >= num_lines)
+      next_estimate_ = 0;
+    if (!estimated_[next_estimate_])
+      break;
+    ++next_estimate_;
+  }
+  const size_t begin = next_estimate_,
+               end = std::min(num_lines, begin + max_lines);
+  // Range reads do not splay, bring begin to the roots first, so that they
+  // do not descend a path left deep by sequential splays.
+  buffer_->GetLineSize(begin);
+  heights_.At(begin);
+  // Laid out lines in range keep their heights.
+  std::vector<long> sizes, heights;
+  buffer_->PeekLineSizes(begin, end, sizes);
+  heights_.PeekRange(begin, end, std::back_inserter(heights));
+  size_t n = 0;
+  for (size_t line = begin; line < end; ++line) {
+    if (estimated_[line])
+      continue;
+    heights[line - begin] = Estimate(sizes[line - begin]);
+    estimated_[line] = true;
+    ++n;
+  }
+  heights_.Replace(begin, heights.begin(), heights.end());
+  num_estimated_ += n;
+  next_estimate_ = end;
+  return n;
+}
+
+void WrapIndex::LayoutLine(size_t line) {
+  if (laid_out_[line])
+    return;
+  const long height = LineView(buffer_, line, width_).height();
+  heights_.Add(line, height - heights_.Peek(line));
+  laid_out_[line] = true;
+  ++num_laid_out_;
+  num_estimated_ += !estimated_[line];
+  estimated_[line] = true;
+}
+
+void WrapIndex::Layout(size_t begin, size_t end) {
+  end = std::min(end, laid_out_.size());
+  for (size_t line = begin; line < end; ++line)
+    LayoutLine(line);
+}
+
+size_t WrapIndex::Refine(size_t max_lines) {
+  // Estimates are much cheaper than layout, and correct most rows.
+  if (size_t n = EstimateLines(max_lines))
+    return n;
+  size_t n = 0;
+  for (; n < max_lines && num_laid_out_ < laid_out_.size(); ++next_line_) {
+    if (next_line_ >= laid_out_.size())
+      next_line_ = 0;
+    if (!laid_out_[next_line_]) {
+      LayoutLine(next_line_);
+      ++n;
+    }
+  }
+  return n;
+}
+
+std::optional<std::pair<size_t, size_t>> WrapIndex::Locate(size_t row) {
+  while (true) {
+    const size_t line = heights_.UpperBound(row);
+    if (line >= laid_out_.size())
+      return std::nullopt;
+    if (laid_out_[line])
+      return std::make_pair(line, row - GetRow(line));
+    // The row may move to another line once the estimate is corrected.
+    LayoutLine(line);
+  }
+}
+
+void WrapIndex::OnLinesChanged(size_t line, size_t removed, size_t inserted) {
+  for (size_t i = line; i < line + removed; ++i) {
+    num_laid_out_ -= laid_out_[i];
+    num_estimated_ -= estimated_[i];
+  }
+  heights_.Erase(line, removed);
+  laid_out_.erase(laid_out_.begin() + line,
+                  laid_out_.begin() + line + removed);
+  estimated_.erase(estimated_.begin() + line,
+                   estimated_.begin() + line + removed);
+  std::vector<long> heights;
+  for (size_t i = line; i < line + inserted; ++i)
+    heights.push_back(Estimate(buffer_->GetLineSize(i)));
+  heights_.Insert(line, heights.begin(), heights.end());
+  laid_out_.insert(laid_out_.begin() + line, inserted, false);
+  estimated_.insert(estimated_.begin() + line, inserted, true);
+  num_estimated_ += inserted;
+  if (next_estimate_ >= line + removed)
+    next_estimate_ += inserted - removed;
+  else if (next_estimate_ > line)
+    next_estimate_ = line;
+  // Batches of edited lines are dropped, batches after them are moved.
+  // Inserted lines are handed to the pool again, and so are lines of
+  // dropped batches.
+  const size_t end = line + removed;
+  next_batch_ = std::min(next_batch_, line);
+  for (auto it = batches_.begin(); it != batches_.end();) {
+    if (it->line + it->size <= line) {
+      ++it;
+    } else if (it->line >= end) {
+      it->line += inserted - removed;
+      ++it;
+    } else {
+      next_batch_ = std::min(next_batch_, it->line);
+      it = batches_.erase(it);
+    }
+  }
+}
+
+bool WrapIndex::SubmitBatch() {
+  const size_t num_lines = laid_out_.size();
+  // Skip lines laid out or being laid out, edits may have moved next_batch_
+  // back before batches still valid.
+  size_t limit = num_lines;
+  for (bool skipped = true; skipped;) {
+    skipped = false;
+    while (next_batch_ < num_lines && laid_out_[next_batch_])
+      ++next_batch_;
+    limit = num_lines;
+    for (auto &batch : batches_) {
+      if (batch.line <= next_batch_ && next_batch_ < batch.line + batch.size) {
+        next_batch_ = batch.line + batch.size;
+        skipped = true;
+      } else if (batch.line > next_batch_) {
+        limit = std::min(limit, batch.line);
+      }
+    }
+  }
+  if (next_batch_ >= num_lines)
+    return false;
+  std::vector<long> sizes;
+  buffer_->PeekLineSizes(next_batch_,
+                         std::min(limit, next_batch_ + kBatchLines), sizes);
+  size_t n = 0, bytes = 0;
+  while (n < sizes.size() && (n == 0 || bytes + sizes[n] <= kBatchBytes))
+    bytes += sizes[n++];
+  size_t offset;
+  buffer_->ComputeOffset(next_batch_, 0, offset);
+  std::string text;
+  buffer_->Read(offset, bytes, text);
+  auto heights = pool_->Submit([text = std::move(text), width = width_] {
+    MonoBuffer buffer;
+    buffer.AppendView(text.data(), text.size());
+    std::vector<long> heights;
+    for (size_t line = 0; line < buffer.NumLines(); ++line)
+      heights.push_back(LineView(&buffer, line, width).height());
+    return heights;
+  });
+  batches_.push_back({next_batch_, n, std::move(heights)});
+  next_batch_ += n;
+  return true;
+}
+
+bool WrapIndex::Sync() {
+  EstimateLines(kEstimateLines);
+  if (!pool_)
+    return num_laid_out_ == laid_out_.size();
+  // Batches are run in order.
+  while (!batches_.empty() &&
+         batches_.front().heights.wait_for(std::chrono::seconds(0)) ==
+             std::future_status::ready) {
+    Batch &batch = batches_.front();
+    const std::vector<long> heights = batch.heights.get();
+    assert(heights.size() == batch.size);
+    for (size_t line = batch.line; line < batch.line + batch.size; ++line) {
+      num_laid_out_ += !laid_out_[line];
+      laid_out_[line] = true;
+      num_estimated_ += !estimated_[line];
+      estimated_[line] = true;
+    }
+    heights_.Replace(batch.line, heights.begin(), heights.end());
+    batches_.pop_front();
+  }
+  // Keep every worker busy while batches are taken.
+  while (batches_.size() < 2 * pool_->size() && SubmitBatch())
+    ;
+  return num_laid_out_ == laid_out_.size();
+}
+
+} // namespace emcc::editor
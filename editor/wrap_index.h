@@ -0,0 +1,110 @@
+#pragma once
+
+#include "core/mono_buffer.h"
+#include "support/prefix_sum.h"
+#include "support/thread_pool.h"
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace emcc::editor {
+
+// Wrapped heights of all lines of a MonoBuffer, so that rows of the whole
+// document map to lines and segments in O(log n). Lines not laid out yet are
+// given heights estimated from their sizes, they are laid out lazily by
+// lookups or Layout, or a few at a time by Refine when idle. Edits of the
+// buffer only reset heights of the edited lines. With a thread pool, lines
+// are also laid out in background, see Sync. After Resize, heights are left
+// at the previous width until lines are estimated again by Refine or Sync,
+// or laid out.
+class WrapIndex {
+public:
+  WrapIndex(MonoBuffer *buffer, size_t width, ThreadPool *pool = nullptr);
+  WrapIndex(const WrapIndex &) = delete;
+  ~WrapIndex();
+
+  size_t width() const { return width_; }
+  // Only flags of lines are reset, heights are not touched. Lines in view
+  // should be laid out by Layout or Locate first, the others are estimated
+  // and laid out by Refine or Sync.
+  void Resize(size_t width);
+
+  size_t NumRows() const {
+    return heights_.empty() ? 0 : heights_.PeekPrefixSum(heights_.size() - 1);
+  }
+  // First row of line, lines before it may be estimated, or still at the
+  // previous width after Resize. NumRows() for lines past the end.
+  size_t GetRow(size_t line) const {
+    line = std::min(line, heights_.size());
+    return line == 0 ? 0 : heights_.PeekPrefixSum(line - 1);
+  }
+  size_t GetHeight(size_t line) const { return heights_.Peek(line); }
+  // Line and segment at row. The line is laid out, so the segment is exact.
+  std::optional<std::pair<size_t, size_t>> Locate(size_t row);
+
+  // Lay out lines [begin, end).
+  void Layout(size_t begin, size_t end);
+  // Estimate at the current width, or once all lines are estimated, lay out
+  // at most max_lines lines. Returns number of lines estimated or laid out,
+  // 0 if all lines are laid out.
+  size_t Refine(size_t max_lines);
+  bool IsLaidOut(size_t line) const {
+    return line < laid_out_.size() && laid_out_[line];
+  }
+  size_t NumLaidOutLines() const { return num_laid_out_; }
+  // Lines whose heights are at the current width, estimated or laid out.
+  size_t NumEstimatedLines() const { return num_estimated_; }
+  // Take heights of lines laid out on the pool, and hand more lines to it.
+  // Workers lay out copies of lines, so that the buffer may be edited
+  // meanwhile, heights of edited lines are dropped. Lines left at the
+  // previous width are estimated again kEstimateLines at a time. Returns true
+  // if all lines are laid out.
+  bool Sync();
+
+private:
+  // Lines [line, line + size) being laid out on the pool.
+  struct Batch {
+    size_t line, size;
+    std::future<std::vector<long>> heights;
+  };
+  // Bytes and lines copied for a batch at most, unless a line is larger.
+  static constexpr size_t kBatchBytes = 1UL << 16;
+  static constexpr size_t kBatchLines = 1UL << 12;
+  // Lines estimated by a Sync, a few milliseconds of work.
+  static constexpr size_t kEstimateLines = 1UL << 15;
+
+  void OnLinesChanged(size_t line, size_t removed, size_t inserted);
+  // Height of a line of size bytes.
+  long Estimate(size_t size) const;
+  // Estimate at most max_lines lines from next_estimate_ which are still at
+  // the previous width. Returns number of estimated lines.
+  size_t EstimateLines(size_t max_lines);
+  void LayoutLine(size_t line);
+  // Hand lines from next_batch_ to the pool. Returns false if all lines are
+  // laid out or being laid out.
+  bool SubmitBatch();
+
+  MonoBuffer *const buffer_;
+  size_t width_;
+  const size_t callback_id_;
+  PrefixSum<long> heights_;
+  std::vector<bool> laid_out_;
+  size_t num_laid_out_;
+  // Heights at width_, estimated or laid out.
+  std::vector<bool> estimated_;
+  size_t num_estimated_ = 0;
+  // EstimateLines resumes from here.
+  size_t next_estimate_ = 0;
+  // Refine resumes from here.
+  size_t next_line_;
+  ThreadPool *const pool_;
+  std::deque<Batch> batches_;
+  // Lines before it are laid out or in batches_.
+  size_t next_batch_ = 0;
+};
+
+} // namespace emcc::editor
@@ -27,5 +27,13 @@ int main(int argc, char *argv[]) {
   if (!buffer->IsUTF8Encoded())
     Die("{} is not utf8 encoded", filename);
   std::signal(SIGWINCH, SendSignal);
-  return 0;
+  ANSITerminal::RegisterAtExitCleaning();
+  if (!ANSITerminal::EnableRawMode(STDIN_FILENO))
+    Die("Failed to enable raw mode");
+  ANSITerminal vt(STDIN_FILENO, STDOUT_FILENO);
+  int height, width;
+  vt.GetMaxYX(height, width);
+  editor::BufferView view(buffer.get(), height, width);
+  Window window(height, width, view, vt);
+  return window.Run();
 }
@@ -2,10 +2,15 @@
 
 #include "editor/buffer_view.h"
 #include "support/chan.h"
+#include "support/histogram.h"
 #include "tui/cursor.h"
+#include "tui/screen.h"
 #include "tui/terminal.h"
 
 #include <atomic>
+#include <chrono>
+#include <unistd.h>
+#include <vector>
 
 namespace emcc {
 
@@ -14,12 +19,28 @@ using SignalQueueTy = GoChan<int>;
 class Window {
 public:
   using Cursor = emcc::tui::Cursor;
+  using Clock = std::chrono::steady_clock;
   explicit Window(int height, int width, emcc::editor::BufferView &view,
-                  emcc::tui::ANSITerminal &vt)
-      : height_(height), width_(width), view_(view), vt_(vt), c_(0, 0),
-        view_reference_row_(0), have_to_stop_(false), status_(0) {}
+                  emcc::tui::ANSITerminal &vt, int max_fps = 60)
+      : height_(height), width_(width), view_(view), vt_(vt),
+        screen_(height, width), c_(0, 0), view_reference_row_(0),
+        have_to_stop_(false), status_(0) {
+    set_max_fps(max_fps);
+  }
 
-  int Run();
+  // Input is drained from fd and applied as it arrives, but a frame is shown
+  // at most once per 1/max_fps seconds, so that a repeated key does not
+  // redraw the screen per press. No limit if max_fps is 0.
+  int Run(int fd = STDIN_FILENO);
+  void set_max_fps(int max_fps) {
+    frame_interval_ = max_fps > 0 ? Clock::duration(std::chrono::seconds(1)) /
+                                        max_fps
+                                  : Clock::duration::zero();
+  }
+  // Microseconds from arrival of a key to the flush of the frame showing it.
+  const Histogram &input_latency() const { return input_latency_; }
+  // Frames shown by Run.
+  size_t num_frames() const { return num_frames_; }
   bool MoveUp();
   bool MoveRight();
   bool MoveDown();
@@ -34,15 +55,26 @@ private:
   Cursor ToBufferViewCursor(emcc::tui::Cursor);
   int buffer_height() const { return height_; }
   bool GetCharView(Cursor c, emcc::editor::CharView &cv);
-  void Consume(const char *input, int n);
+  void Consume(const char *input, int n, Clock::time_point arrival);
+  // Read until no input is left, stop at the end of input.
+  void ReadInput(int fd);
 
   int height_, width_;
   emcc::editor::BufferView &view_;
   emcc::tui::ANSITerminal &vt_;
+  emcc::tui::Screen screen_;
   emcc::tui::Cursor c_;
   int view_reference_row_;
   std::atomic<bool> have_to_stop_;
   int status_;
+  Clock::duration frame_interval_;
+  Clock::time_point next_frame_;
+  // Input applied but not shown yet.
+  bool dirty_ = true;
+  // Arrival of keys applied but not shown yet.
+  std::vector<Clock::time_point> pending_keys_;
+  Histogram input_latency_;
+  size_t num_frames_ = 0;
 };
 
 } // namespace emcc
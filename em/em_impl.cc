@@ -4,8 +4,6 @@
 #include "support/epoll.h"
 #include "support/sys.h"
 
-#include <codecvt>
-#include <locale>
 
 namespace emcc {
 
@@ -120,43 +118,58 @@ void Window::ScrollDown(int num_rows) {
       std::min((int)view_.NumRows(), view_reference_row_ + num_rows);
 }
 
-int Window::Run() {
+int Window::Run(int fd) {
   EPoll m;
   std::vector<epoll_event> events(16);
-  emcc::SetNonBlocking(STDIN_FILENO);
-  m.MonitorReadEvent(STDIN_FILENO);
-  char buf[4096];
+  emcc::SetNonBlocking(fd);
+  m.MonitorReadEvent(fd);
   while (!have_to_stop_) {
-    Show();
+    int timeout = -1;
+    if (dirty_) {
+      const auto now = Clock::now();
+      if (now >= next_frame_) {
+        Show();
+        next_frame_ = now + frame_interval_;
+        continue;
+      }
+      // Input arriving until the next frame is shown with it.
+      timeout = std::chrono::ceil<std::chrono::milliseconds>(next_frame_ - now)
+                    .count();
+    }
     int num_events;
-    if (m.Wait(-1, &events, &num_events)) {
+    if (!m.Wait(timeout, &events, &num_events)) {
       if (errno == EINTR)
         continue;
       status_ = -1;
       break;
     }
     assert(num_events <= events.size());
-    for (int i = 0; i < num_events; ++i) {
-      if (have_to_stop_)
-        break;
-      auto &event = events[i];
-      if (event.data.fd == STDIN_FILENO) {
-        while (true) {
-          int nread = ::read(event.data.fd, buf, GetArrayLength(buf));
-          if (nread < 0 && errno != EAGAIN) {
-            have_to_stop_ = true;
-            status_ = -1;
-            break;
-          }
-          Consume(buf, nread);
-        }
-      }
+    for (int i = 0; i < num_events && !have_to_stop_; ++i) {
+      if (events[i].data.fd == fd)
+        ReadInput(fd);
     }
   }
   return status_;
 }
 
-void Window::Consume(const char *input, int n) {
+void Window::ReadInput(int fd) {
+  char buf[4096];
+  while (!have_to_stop_) {
+    const ssize_t nread = ::read(fd, buf, GetArrayLength(buf));
+    if (nread > 0) {
+      Consume(buf, nread, Clock::now());
+    } else if (nread == 0) {
+      have_to_stop_ = true;
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      break;
+    } else if (errno != EINTR) {
+      have_to_stop_ = true;
+      status_ = -1;
+    }
+  }
+}
+
+void Window::Consume(const char *input, int n, Clock::time_point arrival) {
   for (int i = 0; i < n; ++i) {
     if (input[i] == '\x1B') {
       have_to_stop_ = true;
@@ -175,28 +188,37 @@ void Window::Consume(const char *input, int n) {
     case 'l':
       MoveRight();
       break;
+    default:
+      continue;
     }
+    pending_keys_.push_back(arrival);
+    dirty_ = true;
   }
 }
 
 void Window::Show() {
-  vt_.Clear();
-  // int y = 0;
-  // for (auto row : emcc::make_range(view_.row_begin(), view_.row_end())) {
-  //   int x = 0;
-  //   for (auto &cv : row) {
-  //     std::wstring ws;
-  //     ws.push_back(cv.rune);
-  //     std::string s(to_string(ws));
-  //     vt_.MoveCursor({y, x});
-  //     vt_.Put(s);
-  //     x += cv.length();
-  //   }
-  //   ++y;
-  //   if (y >= height_)
-  //     break;
-  // }
-  vt_.Refresh();
+  screen_.Clear();
+  int y = 0;
+  for (auto row : view_.row_range(view_reference_row_,
+                                  view_reference_row_ + height_)) {
+    int x = 0;
+    for (auto &cv : row) {
+      screen_.Put({y, x}, cv.rune, cv.width);
+      x += cv.length();
+    }
+    ++y;
+  }
+  screen_.set_cursor(c_);
+  screen_.Refresh(vt_);
+  const auto flushed = Clock::now();
+  for (auto arrival : pending_keys_) {
+    input_latency_.Add(std::chrono::duration_cast<std::chrono::microseconds>(
+                           flushed - arrival)
+                           .count());
+  }
+  pending_keys_.clear();
+  dirty_ = false;
+  ++num_frames_;
 }
 
 } // namespace emcc
@@ -0,0 +1,549 @@
+// Copyright (c) 2021 Kai Luo <gluokai@gmail.com>. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <string>
+#include <vector>
+
+namespace emcc {
+
+// A B+ tree rope. Inner nodes keep sizes of their children inline, so a
+// lookup scans a few cache lines per level instead of chasing a pointer per
+// binary node. Leaves hold chars inline. All leaves are at the same depth.
+// Provides the interface of Rope used by MonoBuffer, views are copied since
+// leaves own their chars.
+template <typename Char, size_t kLeafBytes = 1024, size_t kFanout = 32>
+class BTreeRope {
+public:
+  using String = std::basic_string<Char>;
+  static constexpr size_t npos = ~0UL;
+
+private:
+  static constexpr size_t kLeafCapacity = kLeafBytes / sizeof(Char);
+  static_assert(kLeafCapacity >= 2 && kFanout >= 4);
+
+  // count is number of chars of a leaf, or number of children of an inner
+  // node. Whether a node is a leaf is known from its depth.
+  struct Node {
+    size_t count = 0;
+  };
+
+  struct Leaf : Node {
+    Char data[kLeafCapacity];
+  };
+
+  struct Inner : Node {
+    size_t sizes[kFanout];
+    Node *children[kFanout];
+
+    size_t sum() const {
+      size_t s = 0;
+      for (size_t i = 0; i < this->count; ++i)
+        s += sizes[i];
+      return s;
+    }
+  };
+
+  // Path from the root to a leaf.
+  struct Step {
+    Inner *inner;
+    size_t index;
+  };
+  using Path = std::vector<Step>;
+
+  Node *root_;
+  // Number of inner levels, 0 if root_ is a leaf.
+  size_t height_;
+  size_t size_;
+  // Leaf found by the last At and offset of its first char, reset by edits.
+  const Leaf *last_leaf_;
+  size_t last_leaf_start_;
+
+  // Find the leaf containing index, index becomes offset in the leaf.
+  // on_step(inner, i) is called for each inner node on the way. If index is
+  // at the boundary of two children, the left one is chosen when inserting,
+  // so that appending to a leaf needs no new leaf.
+  template <typename F>
+  Leaf *Descend(size_t &index, bool inserting, F &&on_step) const {
+    Node *node = root_;
+    size_t size = size_;
+    for (size_t level = height_; level > 0; --level) {
+      Inner *inner = static_cast<Inner *>(node);
+      size_t i = 0;
+      if (inserting && index == size) {
+        // Appending, skip the scan.
+        i = inner->count - 1;
+        index = inner->sizes[i];
+      } else {
+        while (i + 1 < inner->count && (inserting ? index > inner->sizes[i]
+                                                  : index >= inner->sizes[i])) {
+          index -= inner->sizes[i];
+          ++i;
+        }
+      }
+      size = inner->sizes[i];
+      on_step(inner, i);
+      node = inner->children[i];
+    }
+    return static_cast<Leaf *>(node);
+  }
+
+  Leaf *Descend(size_t &index, bool inserting) const {
+    return Descend(index, inserting, [](Inner *, size_t) {});
+  }
+
+  Leaf *Descend(size_t &index, Path &path, bool inserting) const {
+    return Descend(index, inserting, [&path](Inner *inner, size_t i) {
+      path.push_back({inner, i});
+    });
+  }
+
+  static Leaf *NextLeaf(Path &path) {
+    size_t depth = path.size();
+    while (depth > 0 &&
+           path[depth - 1].index + 1 >= path[depth - 1].inner->count)
+      --depth;
+    assert(depth > 0);
+    Step &step = path[depth - 1];
+    Node *node = step.inner->children[++step.index];
+    for (size_t i = depth; i < path.size(); ++i) {
+      path[i] = {static_cast<Inner *>(node), 0};
+      node = path[i].inner->children[0];
+    }
+    return static_cast<Leaf *>(node);
+  }
+
+  // Insert child at pos of the inner node at depth of path, splitting full
+  // nodes up to the root. Sizes of ancestors must have counted child.
+  void InsertChild(Path &path, size_t depth, size_t pos, Node *child,
+                   size_t child_size) {
+    Inner *inner = path[depth].inner;
+    if (inner->count < kFanout) {
+      std::copy_backward(inner->sizes + pos, inner->sizes + inner->count,
+                         inner->sizes + inner->count + 1);
+      std::copy_backward(inner->children + pos,
+                         inner->children + inner->count,
+                         inner->children + inner->count + 1);
+      inner->sizes[pos] = child_size;
+      inner->children[pos] = child;
+      ++inner->count;
+      return;
+    }
+    Inner *right = new Inner;
+    const size_t half = kFanout / 2;
+    std::copy(inner->sizes + half, inner->sizes + kFanout, right->sizes);
+    std::copy(inner->children + half, inner->children + kFanout,
+              right->children);
+    right->count = kFanout - half;
+    inner->count = half;
+    path[depth] = {pos <= half ? inner : right,
+                   pos <= half ? pos : pos - half};
+    InsertChild(path, depth, path[depth].index, child, child_size);
+    if (depth == 0) {
+      Inner *root = new Inner;
+      root->count = 2;
+      root->children[0] = inner;
+      root->children[1] = right;
+      root->sizes[0] = inner->sum();
+      root->sizes[1] = right->sum();
+      root_ = root;
+      ++height_;
+      return;
+    }
+    Step &parent = path[depth - 1];
+    parent.inner->sizes[parent.index] = inner->sum();
+    InsertChild(path, depth - 1, parent.index + 1, right, right->sum());
+  }
+
+  // Remove the child at the end of path, and ancestors which become empty.
+  void RemoveChild(Path &path, size_t depth) {
+    Inner *inner = path[depth].inner;
+    const size_t pos = path[depth].index;
+    std::copy(inner->sizes + pos + 1, inner->sizes + inner->count,
+              inner->sizes + pos);
+    std::copy(inner->children + pos + 1, inner->children + inner->count,
+              inner->children + pos);
+    if (--inner->count == 0) {
+      if (depth == 0) {
+        delete inner;
+        root_ = nullptr;
+        height_ = 0;
+        return;
+      }
+      delete inner;
+      RemoveChild(path, depth - 1);
+    }
+  }
+
+  void ShrinkRoot() {
+    while (height_ > 0 && root_->count == 1) {
+      Inner *root = static_cast<Inner *>(root_);
+      root_ = root->children[0];
+      delete root;
+      --height_;
+    }
+  }
+
+  // Insert at most kLeafCapacity chars.
+  void InsertIntoLeaf(size_t index, const Char *data, size_t len) {
+    assert(len <= kLeafCapacity);
+    if (root_ == nullptr) {
+      root_ = new Leaf;
+      height_ = 0;
+    }
+    last_leaf_ = nullptr;
+    size_t offset = index;
+    Leaf *leaf = Descend(offset, true);
+    if (leaf->count + len <= kLeafCapacity) {
+      std::copy_backward(leaf->data + offset, leaf->data + leaf->count,
+                         leaf->data + leaf->count + len);
+      std::copy(data, data + len, leaf->data + offset);
+      leaf->count += len;
+      // Sizes are only updated on a second descent, so that the common case
+      // needs no path.
+      Descend(index, true,
+              [len](Inner *inner, size_t i) { inner->sizes[i] += len; });
+      size_ += len;
+      return;
+    }
+    Path path;
+    offset = index;
+    Descend(offset, path, true);
+    size_ += len;
+    // Split the leaf. Chars are appended to a new leaf when appending, so
+    // that leaves stay full.
+    Char buffer[2 * kLeafCapacity];
+    const size_t total = leaf->count + len;
+    std::copy(leaf->data, leaf->data + offset, buffer);
+    std::copy(data, data + len, buffer + offset);
+    std::copy(leaf->data + offset, leaf->data + leaf->count,
+              buffer + offset + len);
+    const size_t left_size = offset == leaf->count ? offset : total / 2;
+    Leaf *right = new Leaf;
+    std::copy(buffer, buffer + left_size, leaf->data);
+    leaf->count = left_size;
+    std::copy(buffer + left_size, buffer + total, right->data);
+    right->count = total - left_size;
+    if (path.empty()) {
+      Inner *root = new Inner;
+      root->count = 2;
+      root->children[0] = leaf;
+      root->children[1] = right;
+      root->sizes[0] = leaf->count;
+      root->sizes[1] = right->count;
+      root_ = root;
+      height_ = 1;
+      return;
+    }
+    for (size_t i = 0; i + 1 < path.size(); ++i)
+      path[i].inner->sizes[path[i].index] += len;
+    path.back().inner->sizes[path.back().index] = leaf->count;
+    InsertChild(path, path.size() - 1, path.back().index + 1, right,
+                right->count);
+  }
+
+  // Erase chars of a single leaf. Returns number of erased chars.
+  size_t EraseInLeaf(size_t index, size_t len) {
+    last_leaf_ = nullptr;
+    Path path;
+    size_t offset = index;
+    Leaf *leaf = Descend(offset, path, false);
+    len = std::min(len, leaf->count - offset);
+    std::copy(leaf->data + offset + len, leaf->data + leaf->count,
+              leaf->data + offset);
+    leaf->count -= len;
+    size_ -= len;
+    for (auto &step : path)
+      step.inner->sizes[step.index] -= len;
+    if (leaf->count == 0) {
+      delete leaf;
+      if (path.empty()) {
+        root_ = nullptr;
+        height_ = 0;
+      } else {
+        RemoveChild(path, path.size() - 1);
+      }
+    } else if (!path.empty()) {
+      MergeWithSibling(path.back());
+    }
+    ShrinkRoot();
+    return len;
+  }
+
+  // Merge a leaf with its right sibling if they fit in one leaf.
+  void MergeWithSibling(Step step) {
+    Inner *parent = step.inner;
+    if (step.index + 1 >= parent->count)
+      step.index = step.index - (step.index > 0);
+    if (step.index + 1 >= parent->count ||
+        parent->sizes[step.index] + parent->sizes[step.index + 1] >
+            kLeafCapacity)
+      return;
+    Leaf *left = static_cast<Leaf *>(parent->children[step.index]);
+    Leaf *right = static_cast<Leaf *>(parent->children[step.index + 1]);
+    std::copy(right->data, right->data + right->count,
+              left->data + left->count);
+    left->count += right->count;
+    parent->sizes[step.index] = left->count;
+    delete right;
+    Path path{{parent, step.index + 1}};
+    RemoveChild(path, 0);
+  }
+
+  // Hang a tree of a lower height as the first or last child of the inner
+  // node at level height + 1 of the leftmost or rightmost path.
+  void Graft(Node *node, size_t height, size_t size, bool at_end) {
+    Path path;
+    Node *parent = root_;
+    for (size_t level = height_; level > height + 1; --level) {
+      Inner *inner = static_cast<Inner *>(parent);
+      const size_t i = at_end ? inner->count - 1 : 0;
+      inner->sizes[i] += size;
+      path.push_back({inner, i});
+      parent = inner->children[i];
+    }
+    Inner *inner = static_cast<Inner *>(parent);
+    path.push_back({inner, at_end ? inner->count : 0});
+    InsertChild(path, path.size() - 1, path.back().index, node, size);
+  }
+
+  // Rope of a subtree of the given height, which may have no chars.
+  static BTreeRope FromNode(Node *node, size_t height) {
+    BTreeRope rope;
+    if (node->count == 0) {
+      Clear(node, height);
+      return rope;
+    }
+    rope.root_ = node;
+    rope.height_ = height;
+    rope.size_ = height == 0 ? node->count : static_cast<Inner *>(node)->sum();
+    rope.ShrinkRoot();
+    return rope;
+  }
+
+  static void Clear(Node *node, size_t height) {
+    if (node == nullptr)
+      return;
+    if (height == 0) {
+      delete static_cast<Leaf *>(node);
+      return;
+    }
+    Inner *inner = static_cast<Inner *>(node);
+    for (size_t i = 0; i < inner->count; ++i)
+      Clear(inner->children[i], height - 1);
+    delete inner;
+  }
+
+public:
+  BTreeRope()
+      : root_(nullptr), height_(0), size_(0), last_leaf_(nullptr),
+        last_leaf_start_(0) {}
+
+  BTreeRope(const String &s) : BTreeRope() { Append(s); }
+
+  BTreeRope(const BTreeRope &) = delete;
+
+  BTreeRope(BTreeRope &&other) : BTreeRope() { swap(std::move(other)); }
+
+  BTreeRope &swap(BTreeRope &&other) {
+    std::swap(root_, other.root_);
+    std::swap(height_, other.height_);
+    std::swap(size_, other.size_);
+    last_leaf_ = other.last_leaf_ = nullptr;
+    return *this;
+  }
+
+  ~BTreeRope() { clear(); }
+
+  void clear() {
+    Clear(root_, height_);
+    last_leaf_ = nullptr;
+    root_ = nullptr;
+    height_ = 0;
+    size_ = 0;
+  }
+
+  size_t size() const { return size_; }
+
+  bool empty() const { return size_ == 0; }
+
+  size_t height() const { return root_ ? height_ + 1 : 0; }
+
+  // The tree is not modified, safe for concurrent readers.
+  Char Peek(size_t index) const {
+    assert(index < size_);
+    return Descend(index, false)->data[index];
+  }
+
+  // Like Peek, but remembers the last visited leaf, which favors repeated
+  // access of nearby chars.
+  Char At(size_t index) {
+    assert(index < size_);
+    if (last_leaf_ == nullptr || index < last_leaf_start_ ||
+        index >= last_leaf_start_ + last_leaf_->count) {
+      last_leaf_start_ = index;
+      size_t offset = index;
+      last_leaf_ = Descend(offset, false);
+      last_leaf_start_ -= offset;
+    }
+    return last_leaf_->data[index - last_leaf_start_];
+  }
+
+  size_t Insert(size_t index, const Char *data, size_t len) {
+    index = std::min(index, size_);
+    for (size_t i = 0; i < len; i += kLeafCapacity)
+      InsertIntoLeaf(index + i, data + i, std::min(kLeafCapacity, len - i));
+    return len;
+  }
+
+  size_t Insert(size_t index, const String &s) {
+    return Insert(index, s.data(), s.size());
+  }
+
+  bool Insert(size_t index, Char c) {
+    InsertIntoLeaf(std::min(index, size_), &c, 1);
+    return true;
+  }
+
+  void Append(Char c) { Insert(size_, c); }
+
+  void Append(const Char *data, size_t len) { Insert(size_, data, len); }
+
+  void Append(const String &s) { Append(s.data(), s.size()); }
+
+  void AppendView(const Char *data, size_t len) { Append(data, len); }
+
+  size_t Erase(size_t index, size_t len, BTreeRope *erased = nullptr) {
+    if (index >= size_)
+      return 0;
+    len = std::min(len, size_ - index);
+    if (erased)
+      Visit(index, len, [erased](const Char *data, size_t n) {
+        erased->Append(data, n);
+      });
+    size_t num_erased = 0;
+    while (num_erased < len)
+      num_erased += EraseInLeaf(index, len - num_erased);
+    return num_erased;
+  }
+
+  BTreeRope &Concat(BTreeRope &&other) {
+    if (other.empty())
+      return *this;
+    if (empty())
+      return swap(std::move(other));
+    if (height_ == other.height_) {
+      Inner *root = new Inner;
+      root->count = 2;
+      root->children[0] = root_;
+      root->children[1] = other.root_;
+      root->sizes[0] = size_;
+      root->sizes[1] = other.size_;
+      root_ = root;
+      ++height_;
+    } else if (height_ > other.height_) {
+      Graft(other.root_, other.height_, other.size_, true);
+    } else {
+      other.Graft(root_, height_, size_, false);
+      root_ = other.root_;
+      height_ = other.height_;
+    }
+    size_ += other.size_;
+    last_leaf_ = nullptr;
+    other.root_ = nullptr;
+    other.height_ = 0;
+    other.size_ = 0;
+    return *this;
+  }
+
+  // Chars from index on are moved to the returned rope. Nodes on the path
+  // to index are cut in two, and the pieces of each side are concatenated
+  // again, so it takes O(log n) node operations instead of copying the tail.
+  BTreeRope Split(size_t index) {
+    BTreeRope tail;
+    if (index >= size_)
+      return tail;
+    if (index == 0) {
+      tail.swap(std::move(*this));
+      return tail;
+    }
+    last_leaf_ = nullptr;
+    Path path;
+    size_t offset = index;
+    Leaf *leaf = Descend(offset, path, false);
+    // Siblings left and right of the path at each level, from the root down.
+    std::vector<BTreeRope> lefts, rights;
+    for (size_t depth = 0; depth < path.size(); ++depth) {
+      Inner *inner = path[depth].inner;
+      const size_t i = path[depth].index, level = height_ - depth;
+      Inner *right = new Inner;
+      right->count = inner->count - i - 1;
+      std::copy(inner->sizes + i + 1, inner->sizes + inner->count,
+                right->sizes);
+      std::copy(inner->children + i + 1, inner->children + inner->count,
+                right->children);
+      inner->count = i;
+      lefts.push_back(FromNode(inner, level));
+      rights.push_back(FromNode(right, level));
+    }
+    Leaf *right_leaf = new Leaf;
+    right_leaf->count = leaf->count - offset;
+    std::copy(leaf->data + offset, leaf->data + leaf->count, right_leaf->data);
+    leaf->count = offset;
+    lefts.push_back(FromNode(leaf, 0));
+    tail.swap(FromNode(right_leaf, 0));
+    while (!rights.empty()) {
+      tail.Concat(std::move(rights.back()));
+      rights.pop_back();
+    }
+    root_ = nullptr;
+    height_ = size_ = 0;
+    for (auto &left : lefts)
+      Concat(std::move(left));
+    return tail;
+  }
+
+  BTreeRope Copy(size_t offset, size_t len) const {
+    BTreeRope result;
+    Visit(offset, len,
+          [&result](const Char *data, size_t n) { result.Append(data, n); });
+    return result;
+  }
+
+  // Calls f(data, n) for each contiguous span of [offset, offset + len) in
+  // order. Returns number of visited chars.
+  template <typename F>
+  size_t Visit(size_t offset, size_t len, F &&f) const {
+    if (offset >= size_)
+      return 0;
+    len = std::min(len, size_ - offset);
+    Path path;
+    Leaf *leaf = Descend(offset, path, false);
+    size_t visited = 0;
+    while (true) {
+      const size_t n = std::min(leaf->count - offset, len - visited);
+      f(static_cast<const Char *>(leaf->data + offset), n);
+      visited += n;
+      if (visited == len)
+        return visited;
+      offset = 0;
+      leaf = NextLeaf(path);
+    }
+  }
+
+  size_t Read(size_t offset, size_t len, Char *out) const {
+    return Visit(offset, len, [&out](const Char *data, size_t n) {
+      out = std::copy(data, data + n, out);
+    });
+  }
+
+  size_t Read(size_t offset, size_t len, String &out) const {
+    return Visit(offset, len, [&out](const Char *data, size_t n) {
+      out.append(data, n);
+    });
+  }
+};
+
+} // namespace emcc
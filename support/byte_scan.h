@@ -0,0 +1,95 @@
+// Copyright (c) 2021 Kai Luo <gluokai@gmail.com>. All rights reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EMCC_X86_SIMD 1
+#endif
+
+namespace emcc {
+
+namespace detail {
+
+template <typename F>
+inline void ForEachByteScalar(const char *data, size_t len, char c, size_t base,
+                              F &f) {
+  for (size_t i = 0; i < len; ++i)
+    if (data[i] == c)
+      f(base + i);
+}
+
+#ifdef EMCC_X86_SIMD
+template <typename F>
+inline void ForEachSetBit(uint32_t mask, size_t base, F &f) {
+  while (mask) {
+    f(base + __builtin_ctz(mask));
+    mask &= mask - 1;
+  }
+}
+
+// SSE2 is part of x86-64 baseline, no dispatch is needed.
+// Returns the number of bytes scanned, the tail is left to the caller.
+template <typename F>
+inline size_t ForEachByteSSE2(const char *data, size_t len, char c, size_t base,
+                              F &f) {
+  const __m128i needle = _mm_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    ForEachSetBit(mask, base + i, f);
+  }
+  return i;
+}
+
+template <typename F>
+__attribute__((target("avx2"))) inline size_t
+ForEachByteAVX2(const char *data, size_t len, char c, size_t base, F &f) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64) {
+    __m256i lo =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    __m256i hi =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 32));
+    uint32_t lo_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+    uint32_t hi_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+    ForEachSetBit(lo_mask, base + i, f);
+    ForEachSetBit(hi_mask, base + i + 32, f);
+  }
+  return i;
+}
+
+inline bool HasAVX2() {
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  return has_avx2;
+}
+#endif
+
+} // namespace detail
+
+// Calls f(i) for every i in [0, len) that data[i] == c, in ascending order.
+// Dense matches are cheap, unlike calling memchr repeatedly.
+template <typename F>
+inline void ForEachByte(const char *data, size_t len, char c, F &&f) {
+  size_t i = 0;
+#ifdef EMCC_X86_SIMD
+  if (detail::HasAVX2())
+    i = detail::ForEachByteAVX2(data, len, c, 0, f);
+  i += detail::ForEachByteSSE2(data + i, len - i, c, i, f);
+#endif
+  detail::ForEachByteScalar(data + i, len - i, c, i, f);
+}
+
+inline size_t CountByte(const char *data, size_t len, char c) {
+  size_t count = 0;
+  ForEachByte(data, len, c, [&count](size_t) { ++count; });
+  return count;
+}
+
+} // namespace emcc
@@ -7,6 +7,7 @@
 #include <atomic>
 #include <cassert>
 #include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -175,7 +176,7 @@ public:
     assert(err > 0);
     err = read(use_sema_, &val, sizeof(val));
     assert(err > 0);
-    chan_.emplace(chan_.begin() + w_, std::forward<E>(e));
+    chan_[w_] = std::forward<E>(e);
     AdvanceWrite();
     val = 1;
     err = write(use_sema_, &val, sizeof(val));
@@ -280,7 +281,7 @@ public:
       cv_.wait(l, [this] { return closed_ || !is_full_nolock(); });
     if (closed_ || is_full_nolock())
       return false;
-    chan_.emplace(chan_.begin() + w_, std::forward<Args>(args)...);
+    chan_[w_] = T(std::forward<Args>(args)...);
     AdvanceWrite();
     uint64_t val = 0;
     read(put_sema_, &val, sizeof(val));
@@ -315,7 +316,7 @@ public:
     }
     if (get_sema_ >= 0) {
       ::close(get_sema_);
-      put_sema_ = -1;
+      get_sema_ = -1;
     }
   }
 
@@ -368,4 +369,213 @@ private:
   int get_sema_, put_sema_;
 };
 
+namespace detail {
+
+// Optional eventfd of a lock free ring. It becomes readable when the ring
+// turns non-empty, instead of counting items like GoChan, so that a put into
+// a non-empty ring makes no syscall.
+class RingEvent {
+public:
+  explicit RingEvent(bool enabled)
+      : fd_(enabled ? eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK) : -1) {}
+  RingEvent(const RingEvent &) = delete;
+  ~RingEvent() {
+    if (fd_ >= 0)
+      ::close(fd_);
+  }
+
+  int fd() const { return fd_; }
+  bool enabled() const { return fd_ >= 0; }
+  void Notify() {
+    uint64_t val = 1;
+    [[maybe_unused]] ssize_t err = ::write(fd_, &val, sizeof(val));
+  }
+  void Reset() {
+    uint64_t val;
+    [[maybe_unused]] ssize_t err = ::read(fd_, &val, sizeof(val));
+  }
+
+private:
+  const int fd_;
+};
+
+inline size_t RingCapacity(size_t cap) {
+  size_t n = 1;
+  while (n < cap)
+    n <<= 1;
+  return n;
+}
+
+// Keep indices written by different threads in different cache lines.
+constexpr size_t kCacheLineSize = 64;
+
+} // namespace detail
+
+// Lock free bounded ring for a single producer and a single consumer. put
+// and get never block, they return false if the ring is full or empty. The
+// capacity is rounded up to a power of two.
+//
+// With notify, receive_chan is an eventfd to wait on by EPoll. It is written
+// only when the ring turns non-empty, so a consumer woken by it must call
+// reset_receive_chan before it gets items until the ring is empty, or a
+// wakeup may be lost.
+template <typename T>
+class SPSCChan {
+public:
+  explicit SPSCChan(size_t cap, bool notify = false)
+      : mask_(detail::RingCapacity(cap) - 1), chan_(mask_ + 1),
+        event_(notify) {}
+  SPSCChan(const SPSCChan &) = delete;
+
+  int receive_chan() const { return event_.fd(); }
+  void reset_receive_chan() { event_.Reset(); }
+
+  template <typename... Args>
+  bool put(Args &&...args) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_)
+        return false;
+    }
+    chan_[tail & mask_] = T(std::forward<Args>(args)...);
+    tail_.store(tail + 1, std::memory_order_release);
+    if (event_.enabled()) {
+      // Pairs with the fence in get, either the consumer sees this item, or
+      // this sees that the consumer has taken all items before it.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (head_.load(std::memory_order_relaxed) == tail)
+        event_.Notify();
+    }
+    return true;
+  }
+
+  bool get(T &receiver) {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      if (event_.enabled())
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_)
+        return false;
+    }
+    receiver = std::move(chan_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+  // Exact only if neither end is in use.
+  size_t size() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+  bool empty() const { return size() == 0; }
+
+private:
+  const size_t mask_;
+  std::vector<T> chan_;
+  detail::RingEvent event_;
+  // Written by the consumer.
+  alignas(detail::kCacheLineSize) std::atomic<size_t> head_{0};
+  size_t tail_cache_ = 0;
+  // Written by the producer.
+  alignas(detail::kCacheLineSize) std::atomic<size_t> tail_{0};
+  size_t head_cache_ = 0;
+};
+
+// Lock free bounded ring for any number of producers and consumers. Each
+// slot has a sequence number telling whether it is ready for the put or the
+// get of a round, so that producers and consumers only contend on claiming
+// indices. See SPSCChan for the eventfd.
+template <typename T>
+class MPMCChan {
+public:
+  explicit MPMCChan(size_t cap, bool notify = false)
+      : mask_(detail::RingCapacity(cap) - 1),
+        chan_(std::make_unique<Slot[]>(mask_ + 1)), event_(notify) {
+    for (size_t i = 0; i <= mask_; ++i)
+      chan_[i].seq.store(i, std::memory_order_relaxed);
+  }
+  MPMCChan(const MPMCChan &) = delete;
+
+  int receive_chan() const { return event_.fd(); }
+  void reset_receive_chan() { event_.Reset(); }
+
+  template <typename... Args>
+  bool put(Args &&...args) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &chan_[pos & mask_];
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const long diff = long(seq - pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = T(std::forward<Args>(args)...);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    if (event_.enabled()) {
+      // Pairs with the fence in get. Items before pos have been taken, so
+      // the ring has turned non-empty.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (head_.load(std::memory_order_relaxed) == pos)
+        event_.Notify();
+    }
+    return true;
+  }
+
+  bool get(T &receiver) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true) {
+      slot = &chan_[pos & mask_];
+      if (event_.enabled())
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      const size_t seq = slot->seq.load(std::memory_order_acquire);
+      const long diff = long(seq - (pos + 1));
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+    receiver = std::move(slot->value);
+    slot->seq.store(pos + mask_ + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+  // Exact only if the ring is not in use.
+  size_t size() const {
+    const size_t head = head_.load(std::memory_order_acquire);
+    const size_t tail = tail_.load(std::memory_order_acquire);
+    return tail > head ? tail - head : 0;
+  }
+  bool empty() const { return size() == 0; }
+
+private:
+  struct Slot {
+    std::atomic<size_t> seq;
+    T value;
+  };
+
+  const size_t mask_;
+  std::unique_ptr<Slot[]> chan_;
+  detail::RingEvent event_;
+  alignas(detail::kCacheLineSize) std::atomic<size_t> head_{0};
+  alignas(detail::kCacheLineSize) std::atomic<size_t> tail_{0};
+};
+
 } // namespace emcc
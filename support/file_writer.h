@@ -0,0 +1,145 @@
+// Copyright (c) 2021 Kai Luo <gluokai@gmail.com>. All rights reserved.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace emcc {
+
+enum class SyncPolicy {
+  // Leave writeback to the kernel.
+  kNone,
+  // fdatasync the file before renaming it.
+  kData,
+  // fsync the file before renaming it, and the directory after.
+  kFull,
+};
+
+// Replace a file atomically. Data is written to a temporary file in the same
+// directory, which is renamed over the target on Commit. Spans are gathered
+// and written with writev, so they must stay valid until Flush or Commit.
+class AtomicFileWriter {
+public:
+  explicit AtomicFileWriter(const std::string &filename,
+                            SyncPolicy policy = SyncPolicy::kFull)
+      : filename_(filename), tempfile_(filename + ".XXXXXX"), policy_(policy),
+        fd_(-1), ok_(false) {
+    fd_ = ::mkstemp(tempfile_.data());
+    if (fd_ < 0)
+      return;
+    // mkstemp creates the file with 0600, keep the mode of the target, or
+    // create it like open(2) would.
+    struct stat statbuf;
+    const mode_t mode = ::stat(filename.c_str(), &statbuf)
+                            ? 0666 & ~GetUmask()
+                            : statbuf.st_mode & 07777;
+    ok_ = !::fchmod(fd_, mode);
+  }
+
+  AtomicFileWriter(const AtomicFileWriter &) = delete;
+
+  bool is_open() const { return fd_ >= 0; }
+
+  bool Write(const char *data, size_t len) {
+    if (len == 0)
+      return ok_;
+    iovecs_.push_back({const_cast<char *>(data), len});
+    if (iovecs_.size() >= IOV_MAX)
+      return Flush();
+    return ok_;
+  }
+
+  bool Flush() {
+    size_t i = 0;
+    while (ok_ && i < iovecs_.size()) {
+      const size_t n = std::min(iovecs_.size() - i, size_t(IOV_MAX));
+      ssize_t written = ::writev(fd_, &iovecs_[i], n);
+      if (written < 0) {
+        ok_ = errno == EINTR;
+        continue;
+      }
+      // Spans are never empty, no progress would loop forever.
+      if (written == 0) {
+        errno = EIO;
+        ok_ = false;
+        break;
+      }
+      // Skip written spans, the last one may be partially written.
+      for (; written > 0; ++i) {
+        struct iovec &iov = iovecs_[i];
+        if (size_t(written) < iov.iov_len) {
+          iov.iov_base = static_cast<char *>(iov.iov_base) + written;
+          iov.iov_len -= written;
+          break;
+        }
+        written -= iov.iov_len;
+      }
+    }
+    iovecs_.clear();
+    return ok_;
+  }
+
+  bool Commit() {
+    if (!is_open() || !Flush())
+      return false;
+    if (policy_ == SyncPolicy::kData)
+      ok_ = !::fdatasync(fd_);
+    else if (policy_ == SyncPolicy::kFull)
+      ok_ = !::fsync(fd_);
+    ok_ = !::close(fd_) && ok_;
+    fd_ = -1;
+    ok_ = ok_ && !::rename(tempfile_.c_str(), filename_.c_str());
+    if (!ok_) {
+      ::unlink(tempfile_.c_str());
+      return false;
+    }
+    if (policy_ == SyncPolicy::kFull)
+      SyncDirectory();
+    return true;
+  }
+
+  // The target is untouched if not committed.
+  ~AtomicFileWriter() {
+    if (fd_ < 0)
+      return;
+    ::close(fd_);
+    ::unlink(tempfile_.c_str());
+  }
+
+private:
+  // umask can only be read by setting it, so it is set back at once.
+  static mode_t GetUmask() {
+    const mode_t mask = ::umask(0);
+    ::umask(mask);
+    return mask;
+  }
+
+  void SyncDirectory() {
+    const size_t slash = filename_.rfind('/');
+    const std::string dir =
+        slash == std::string::npos ? "." : filename_.substr(0, slash + 1);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0)
+      return;
+    ::fsync(fd);
+    ::close(fd);
+  }
+
+  const std::string filename_;
+  std::string tempfile_;
+  const SyncPolicy policy_;
+  int fd_;
+  bool ok_;
+  std::vector<struct iovec> iovecs_;
+};
+
+} // namespace emcc
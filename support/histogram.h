@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace emcc {
+
+// Counts of samples in buckets growing exponentially, so that percentiles of
+// e.g. latencies are kept in constant space. Each power of two is split into
+// kSubBuckets buckets, a percentile is off by 1/kSubBuckets at most.
+class Histogram {
+public:
+  static constexpr size_t kSubBuckets = 16;
+
+  void Add(uint64_t value) {
+    ++buckets_[BucketOf(value)];
+    ++count_;
+    max_ = std::max(max_, value);
+  }
+
+  // Upper bound of the p-th (in [0, 1]) percentile of samples.
+  uint64_t Percentile(double p) const {
+    if (count_ == 0)
+      return 0;
+    const size_t rank =
+        std::max<size_t>(1, std::min<size_t>(count_, std::ceil(p * count_)));
+    size_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); ++i) {
+      seen += buckets_[i];
+      if (seen >= rank)
+        return std::min(UpperBound(i), max_);
+    }
+    return max_;
+  }
+
+  size_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+  void clear() {
+    buckets_.fill(0);
+    count_ = 0;
+    max_ = 0;
+  }
+
+private:
+  static constexpr int kSubBits = 4;
+  static_assert(kSubBuckets == 1UL << kSubBits);
+
+  static size_t BucketOf(uint64_t value) {
+    if (value < kSubBuckets)
+      return value;
+    const int shift = 63 - __builtin_clzll(value) - kSubBits;
+    return (shift + 1) * kSubBuckets + (value >> shift) - kSubBuckets;
+  }
+
+  static uint64_t UpperBound(size_t bucket) {
+    if (bucket < kSubBuckets)
+      return bucket;
+    const int shift = bucket / kSubBuckets - 1;
+    const uint64_t mantissa = bucket % kSubBuckets + kSubBuckets;
+    return ((mantissa + 1) << shift) - 1;
+  }
+
+  std::array<size_t, (64 - kSubBits + 1) * kSubBuckets> buckets_{};
+  size_t count_ = 0;
+  uint64_t max_ = 0;
+};
+
+} // namespace emcc
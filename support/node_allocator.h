@@ -0,0 +1,141 @@
+// Copyright (c) 2021 Kai Luo <gluokai@gmail.com>. All rights reserved.
+
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace emcc {
+
+// Node allocators of trees. Besides New and Delete, an allocator supports
+//   Share: returns an allocator for a tree split from this one.
+//   Absorb: takes over the allocator of a tree concatenated to this one.
+//   Reset: frees all nodes at once without calling destructors, returns
+//          false if not supported.
+
+template <typename T>
+class NewAllocator {
+public:
+  template <typename... Args>
+  T *New(Args &&...args) {
+    return new T(std::forward<Args>(args)...);
+  }
+  void Delete(T *p) { delete p; }
+  NewAllocator Share() const { return NewAllocator(); }
+  void Absorb(NewAllocator &&) {}
+  bool Reset() { return false; }
+};
+
+// Allocates nodes from slabs of a pool, freed nodes are reused via a free
+// list. Trees split from a tree share its pool, and a tree retains pools of
+// trees concatenated to it, so nodes never outlive their slabs. Pools are
+// not thread-safe, trees sharing a pool must be used by the same thread.
+template <typename T>
+class PoolAllocator {
+private:
+  static constexpr size_t kNodesPerSlab = 1024;
+
+  union Slot {
+    Slot *next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  struct Pool {
+    std::vector<std::unique_ptr<Slot[]>> slabs;
+    // Number of used slots in the last slab.
+    size_t used = kNodesPerSlab;
+    Slot *free_head = nullptr, *free_tail = nullptr;
+    // Pools of nodes absorbed from other trees.
+    std::vector<std::shared_ptr<Pool>> retained;
+
+    void *Allocate() {
+      if (free_head) {
+        Slot *slot = free_head;
+        free_head = slot->next;
+        if (free_head == nullptr)
+          free_tail = nullptr;
+        return slot;
+      }
+      if (used == kNodesPerSlab) {
+        slabs.emplace_back(new Slot[kNodesPerSlab]);
+        used = 0;
+      }
+      return &slabs.back()[used++];
+    }
+
+    void Free(void *p) {
+      Slot *slot = static_cast<Slot *>(p);
+      slot->next = free_head;
+      free_head = slot;
+      if (free_tail == nullptr)
+        free_tail = slot;
+    }
+
+    void Retain(const std::shared_ptr<Pool> &pool) {
+      if (pool.get() == this)
+        return;
+      for (auto &p : retained)
+        if (p == pool)
+          return;
+      retained.emplace_back(pool);
+    }
+
+    // other must not be referred by anyone else.
+    void Steal(Pool &other) {
+      while (other.used < kNodesPerSlab)
+        Free(&other.slabs.back()[other.used++]);
+      for (auto &slab : other.slabs)
+        slabs.emplace_back(std::move(slab));
+      if (other.free_head) {
+        other.free_tail->next = free_head;
+        free_head = other.free_head;
+        if (free_tail == nullptr)
+          free_tail = other.free_tail;
+      }
+      for (auto &pool : other.retained)
+        Retain(pool);
+      other = Pool();
+    }
+  };
+
+  explicit PoolAllocator(const std::shared_ptr<Pool> &pool) : pool_(pool) {}
+
+  std::shared_ptr<Pool> pool_;
+
+public:
+  PoolAllocator() : pool_(std::make_shared<Pool>()) {}
+
+  template <typename... Args>
+  T *New(Args &&...args) {
+    return new (pool_->Allocate()) T(std::forward<Args>(args)...);
+  }
+
+  void Delete(T *p) {
+    if (p == nullptr)
+      return;
+    p->~T();
+    pool_->Free(p);
+  }
+
+  PoolAllocator Share() const { return PoolAllocator(pool_); }
+
+  void Absorb(PoolAllocator &&other) {
+    if (other.pool_ == pool_)
+      return;
+    if (other.pool_.use_count() == 1)
+      pool_->Steal(*other.pool_);
+    else
+      pool_->Retain(other.pool_);
+  }
+
+  // Only if the pool is not shared with other trees.
+  bool Reset() {
+    if (pool_.use_count() != 1)
+      return false;
+    *pool_ = Pool();
+    return true;
+  }
+};
+
+} // namespace emcc
@@ -0,0 +1,249 @@
+// Copyright (c) 2021 Kai Luo <gluokai@gmail.com>. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace emcc {
+
+// An AVL balanced rope of immutable, reference counted nodes. Edits copy the
+// path to the edited leaf and share everything else, so Snapshot is O(1) and
+// each edit costs O(log n) new nodes. Snapshots can be read on other threads
+// while the rope keeps being edited, but a single PersistentRope object must
+// not be used by multiple threads concurrently.
+template <typename Char, size_t kMaxPieceSize = 4096>
+class PersistentRope {
+private:
+  using String = std::basic_string<Char>;
+
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  // Only leaves have pieces, inner nodes always have both children.
+  struct Node {
+    size_t size, height;
+    NodePtr left, right;
+    String piece;
+
+    Node(String &&p) : size(p.size()), height(1), piece(std::move(p)) {}
+
+    Node(const NodePtr &l, const NodePtr &r)
+        : size(l->size + r->size), height(std::max(l->height, r->height) + 1),
+          left(l), right(r) {}
+
+    bool is_leaf() const { return left == nullptr; }
+  };
+
+  static size_t Height(const NodePtr &node) {
+    return node ? node->height : 0;
+  }
+
+  static NodePtr MakeLeaf(String &&piece) {
+    return std::make_shared<const Node>(std::move(piece));
+  }
+
+  static NodePtr MakeInner(const NodePtr &l, const NodePtr &r) {
+    return std::make_shared<const Node>(l, r);
+  }
+
+  // Heights of l and r differ by at most 2.
+  static NodePtr Balance(const NodePtr &l, const NodePtr &r) {
+    if (Height(l) > Height(r) + 1) {
+      if (Height(l->left) >= Height(l->right))
+        return MakeInner(l->left, MakeInner(l->right, r));
+      return MakeInner(MakeInner(l->left, l->right->left),
+                       MakeInner(l->right->right, r));
+    }
+    if (Height(r) > Height(l) + 1) {
+      if (Height(r->right) >= Height(r->left))
+        return MakeInner(MakeInner(l, r->left), r->right);
+      return MakeInner(MakeInner(l, r->left->left),
+                       MakeInner(r->left->right, r->right));
+    }
+    return MakeInner(l, r);
+  }
+
+  static NodePtr Join(const NodePtr &l, const NodePtr &r) {
+    if (l == nullptr)
+      return r;
+    if (r == nullptr)
+      return l;
+    if (l->is_leaf() && r->is_leaf() && l->size + r->size <= kMaxPieceSize)
+      return MakeLeaf(l->piece + r->piece);
+    if (Height(l) > Height(r) + 1)
+      return Balance(l->left, Join(l->right, r));
+    if (Height(r) > Height(l) + 1)
+      return Balance(Join(l, r->left), r->right);
+    return MakeInner(l, r);
+  }
+
+  // Split into [0, index) and [index, size).
+  static std::pair<NodePtr, NodePtr> Split(const NodePtr &node, size_t index) {
+    if (node == nullptr || index >= node->size)
+      return {node, nullptr};
+    if (index == 0)
+      return {nullptr, node};
+    if (node->is_leaf())
+      return {MakeLeaf(node->piece.substr(0, index)),
+              MakeLeaf(node->piece.substr(index))};
+    const size_t left_size = node->left->size;
+    if (index == left_size)
+      return {node->left, node->right};
+    if (index < left_size) {
+      auto [l, r] = Split(node->left, index);
+      return {l, Join(r, node->right)};
+    }
+    auto [l, r] = Split(node->right, index - left_size);
+    return {Join(node->left, l), r};
+  }
+
+  // Copy the path to the leaf at index and insert data into the leaf.
+  // Returns nullptr if the leaf has no room for data.
+  static NodePtr InsertIntoLeaf(const NodePtr &node, size_t index,
+                                const Char *data, size_t len) {
+    if (node->is_leaf()) {
+      if (node->size + len > kMaxPieceSize)
+        return nullptr;
+      String piece(node->piece);
+      piece.insert(index, data, len);
+      return MakeLeaf(std::move(piece));
+    }
+    const size_t left_size = node->left->size;
+    if (index <= left_size) {
+      NodePtr l = InsertIntoLeaf(node->left, index, data, len);
+      return l ? MakeInner(l, node->right) : nullptr;
+    }
+    NodePtr r = InsertIntoLeaf(node->right, index - left_size, data, len);
+    return r ? MakeInner(node->left, r) : nullptr;
+  }
+
+  // Build a perfectly balanced tree of pieces [first, last).
+  static NodePtr Build(const Char *data, size_t len, size_t first,
+                       size_t last) {
+    if (first >= last)
+      return nullptr;
+    if (first + 1 == last) {
+      const size_t offset = first * kMaxPieceSize;
+      return MakeLeaf(
+          String(data + offset, std::min(kMaxPieceSize, len - offset)));
+    }
+    const size_t mid = first + (last - first) / 2;
+    return MakeInner(Build(data, len, first, mid),
+                     Build(data, len, mid, last));
+  }
+
+  static NodePtr Build(const Char *data, size_t len) {
+    return Build(data, len, 0, (len + kMaxPieceSize - 1) / kMaxPieceSize);
+  }
+
+  NodePtr root_;
+
+public:
+  static constexpr size_t npos = ~0UL;
+
+  PersistentRope() = default;
+
+  PersistentRope(const String &s) : root_(Build(s.data(), s.size())) {}
+
+  // The returned rope shares all nodes with this one, and is not affected by
+  // later edits of this one.
+  PersistentRope Snapshot() const { return *this; }
+
+  size_t size() const { return root_ ? root_->size : 0; }
+
+  bool empty() const { return size() == 0; }
+
+  size_t height() const { return Height(root_); }
+
+  Char At(size_t index) const {
+    assert(index < size());
+    const Node *node = root_.get();
+    while (!node->is_leaf()) {
+      const size_t left_size = node->left->size;
+      if (index < left_size) {
+        node = node->left.get();
+      } else {
+        index -= left_size;
+        node = node->right.get();
+      }
+    }
+    return node->piece[index];
+  }
+
+  size_t Insert(size_t index, const Char *data, size_t len) {
+    if (len == 0)
+      return 0;
+    index = std::min(index, size());
+    if (root_ && len <= kMaxPieceSize) {
+      if (NodePtr node = InsertIntoLeaf(root_, index, data, len)) {
+        root_ = std::move(node);
+        return len;
+      }
+    }
+    auto [l, r] = Split(root_, index);
+    root_ = Join(Join(l, Build(data, len)), r);
+    return len;
+  }
+
+  size_t Insert(size_t index, const String &s) {
+    return Insert(index, s.data(), s.size());
+  }
+
+  bool Insert(size_t index, Char c) { return Insert(index, &c, 1); }
+
+  void Append(const Char *data, size_t len) { Insert(size(), data, len); }
+
+  void Append(const String &s) { Append(s.data(), s.size()); }
+
+  size_t Erase(size_t index, size_t len) {
+    if (index >= size() || len == 0)
+      return 0;
+    len = std::min(len, size() - index);
+    auto [l, rest] = Split(root_, index);
+    root_ = Join(l, Split(rest, len).second);
+    return len;
+  }
+
+  // Calls f(data, n) for each contiguous span of [offset, offset + len) in
+  // order. Returns number of visited chars.
+  template <typename F>
+  size_t Visit(size_t offset, size_t len, F &&f) const {
+    if (offset >= size())
+      return 0;
+    len = std::min(len, size() - offset);
+    Visit(root_.get(), offset, len, f);
+    return len;
+  }
+
+  size_t Read(size_t offset, size_t len, String &out) const {
+    return Visit(offset, len, [&out](const Char *data, size_t n) {
+      out.append(data, n);
+    });
+  }
+
+  void clear() { root_.reset(); }
+
+private:
+  template <typename F>
+  static void Visit(const Node *node, size_t offset, size_t len, F &f) {
+    if (node->is_leaf()) {
+      f(node->piece.data() + offset, len);
+      return;
+    }
+    const size_t left_size = node->left->size;
+    if (offset < left_size) {
+      const size_t n = std::min(len, left_size - offset);
+      Visit(node->left.get(), offset, n, f);
+      if (n < len)
+        Visit(node->right.get(), 0, len - n, f);
+    } else {
+      Visit(node->right.get(), offset - left_size, len, f);
+    }
+  }
+};
+
+} // namespace emcc
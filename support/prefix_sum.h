@@ -6,6 +6,8 @@
 
 #include <cassert>
 #include <iostream>
+#include <iterator>
+#include <utility>
 #include <vector>
 
 namespace emcc {
@@ -15,6 +17,7 @@ struct PrefixSumPiece : public DefaultPiece {
   Num value, prefix_sum, sum;
   using Super = DefaultPiece;
   PrefixSumPiece() = default;
+  PrefixSumPiece(Num value) : value(value), prefix_sum(), sum() {}
 
   template <typename T>
   static void UpdateNode(SplayRopeNode<T> *node) {
@@ -28,19 +31,27 @@ struct PrefixSumPiece : public DefaultPiece {
   }
 };
 
-template <typename Num>
-class PrefixSum : public SplayRope<PrefixSumPiece<Num>> {
+template <typename Num, template <typename> class Allocator = NewAllocator>
+class PrefixSum : public SplayRope<PrefixSumPiece<Num>, Allocator> {
 public:
-  using Super = SplayRope<PrefixSumPiece<Num>>;
+  using Super = SplayRope<PrefixSumPiece<Num>, Allocator>;
   using PieceTy = typename Super::PieceTy;
 
   Num At(size_t i) {
     if (i >= Super::size())
       return Num();
+    if (!Super::splay_on_read())
+      return Peek(i);
     PieceTy &piece = Super::At(i);
     return piece.value;
   }
 
+  Num Peek(size_t i) const {
+    if (i >= Super::size())
+      return Num();
+    return Super::Peek(i).value;
+  }
+
   PrefixSum &Insert(size_t i, Num x) {
     PieceTy piece;
     piece.value = x;
@@ -48,46 +59,181 @@ public:
     return *this;
   }
 
+  // Append values in [begin, end), in a single balanced construction.
+  template <typename Iterator>
+  PrefixSum &Append(Iterator begin, Iterator end) {
+    Super::AppendRange(begin, end);
+    return *this;
+  }
+
+  // Replace all values with [begin, end). Nodes are reused if the size is
+  // unchanged, which saves allocating and freeing one node per value.
+  template <typename Iterator>
+  PrefixSum &Assign(Iterator begin, Iterator end) {
+    if (size_t(std::distance(begin, end)) != Super::size()) {
+      Super::clear();
+      return Append(begin, end);
+    }
+    return Replace(0, begin, end);
+  }
+
+  // Replace values from the i-th one with [begin, end) in place, the shape of
+  // the tree is kept, unlike Erase and Insert.
+  template <typename Iterator>
+  PrefixSum &Replace(size_t i, Iterator begin, Iterator end) {
+    const size_t last = i + std::distance(begin, end);
+    assert(last <= Super::size());
+    // Values are assigned in order, sums are updated once both subtrees are
+    // done. Subtrees out of range are skipped. Iterative, since the tree may
+    // be deep after splays.
+    struct Frame {
+      Node *node;
+      // Index of the first value of the subtree.
+      size_t first;
+      bool visited;
+    };
+    std::vector<Frame> stack;
+    Node *node = Super::root();
+    size_t first = 0;
+    while (node || !stack.empty()) {
+      if (node) {
+        if (first >= last || first + node->size <= i) {
+          node = nullptr;
+          continue;
+        }
+        stack.push_back({node, first, false});
+        node = node->left;
+      } else if (!stack.back().visited) {
+        Frame &frame = stack.back();
+        frame.visited = true;
+        const size_t index = frame.first + frame.node->left_size();
+        if (index >= i && index < last)
+          frame.node->piece.value = *begin++;
+        node = frame.node->right;
+        first = index + 1;
+      } else {
+        stack.back().node->update();
+        stack.pop_back();
+      }
+    }
+    return *this;
+  }
+
+  // Insert values in [begin, end) before the i-th value.
+  template <typename Iterator>
+  PrefixSum &Insert(size_t i, Iterator begin, Iterator end) {
+    Super::InsertRange(i, begin, end);
+    return *this;
+  }
+
   Num GetPrefixSum(size_t i) {
     if (i >= Super::size())
       return Num();
+    if (!Super::splay_on_read())
+      return PeekPrefixSum(i);
     PieceTy &piece = Super::At(i);
     return piece.prefix_sum;
   }
 
+  // Like GetPrefixSum, but the tree is not modified.
+  Num PeekPrefixSum(size_t i) const {
+    if (i >= Super::size())
+      return Num();
+    Num sum = Num();
+    const Node *node = Super::root();
+    while (true) {
+      const size_t left_size = node->left_size();
+      if (i < left_size) {
+        node = node->left;
+      } else if (i == left_size) {
+        return sum + node->piece.prefix_sum;
+      } else {
+        sum += node->piece.prefix_sum;
+        i -= left_size + 1;
+        node = node->right;
+      }
+    }
+  }
+
+  // Write values [begin, end) to out in order, the tree is not modified, so
+  // that a long sequential read does not leave it unbalanced.
+  template <typename OutputIt>
+  OutputIt PeekRange(size_t begin, size_t end, OutputIt out) const {
+    end = std::min(end, Super::size());
+    if (begin >= end)
+      return out;
+    // Ancestors whose values are not visited yet.
+    std::vector<const Node *> stack;
+    const Node *node = Super::root();
+    for (size_t i = begin;;) {
+      const size_t left_size = node->left_size();
+      if (i < left_size) {
+        stack.push_back(node);
+        node = node->left;
+      } else if (i == left_size) {
+        break;
+      } else {
+        i -= left_size + 1;
+        node = node->right;
+      }
+    }
+    for (size_t n = end - begin;;) {
+      *out++ = node->piece.value;
+      if (--n == 0)
+        return out;
+      if (node->right) {
+        node = node->right;
+        while (node->left) {
+          stack.push_back(node);
+          node = node->left;
+        }
+      } else {
+        node = stack.back();
+        stack.pop_back();
+      }
+    }
+  }
+
   bool Add(size_t i, Num delta) {
     if (i >= Super::size())
       return false;
     PieceTy &piece = Super::At(i);
     piece.value += delta;
+    Super::UpdateRoot();
     return true;
   }
 
-  // Find first i, GetPrefixSum(i) >= x.
-  size_t LowerBound(Num x) {
-    size_t l = 0, r = Super::size(), mid = l + (r - l) / 2;
-    while (l < r) {
-      if (GetPrefixSum(mid) >= x) {
-        r = mid;
-      } else {
-        l = mid + 1;
-      }
-      mid = l + (r - l) / 2;
-    }
-    return r;
+  // Find first i, GetPrefixSum(i) >= x. Values must not be negative.
+  size_t LowerBound(Num x) const {
+    return Search([x](Num sum) { return sum >= x; });
   }
 
-  size_t UpperBound(Num x) {
-    size_t l = 0, r = Super::size(), mid = l + (r - l) / 2;
-    while (l < r) {
-      if (GetPrefixSum(mid) > x) {
-        r = mid;
+  size_t UpperBound(Num x) const {
+    return Search([x](Num sum) { return sum > x; });
+  }
+
+private:
+  using Node = typename Super::Node;
+
+  // Find first i that pred(GetPrefixSum(i)) holds, by a single descent
+  // rather than a binary search over GetPrefixSum.
+  template <typename Pred>
+  size_t Search(Pred pred) const {
+    size_t result = Super::size(), index = 0;
+    Num sum = Num();
+    const Node *node = Super::root();
+    while (node) {
+      const Num prefix_sum = sum + node->piece.prefix_sum;
+      if (pred(prefix_sum)) {
+        result = index + node->left_size();
+        node = node->left;
       } else {
-        l = mid + 1;
+        sum = prefix_sum;
+        index += node->left_size() + 1;
+        node = node->right;
       }
-      mid = l + (r - l) / 2;
     }
-    return r;
+    return result;
   }
 };
 
@@ -2,20 +2,113 @@
 
 #pragma once
 
+#include "support/node_allocator.h"
+
+#include <algorithm>
 #include <assert.h>
 #include <cstring>
 #include <iostream>
 #include <set>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace emcc {
 
-template <typename Char, size_t kMaxPieceSize = 4096>
+// A piece either owns its data, or refers to a read-only span outliving the
+// rope, e.g., an mmapped file. A referred span is copied on first write.
+template <typename Char>
+class RopePiece {
+public:
+  using String = std::basic_string<Char>;
+
+  RopePiece() : view_(nullptr), view_size_(0) {}
+
+  RopePiece(const Char *data, size_t len)
+      : owned_(data, len), view_(nullptr), view_size_(0) {}
+
+  static RopePiece View(const Char *data, size_t len) {
+    RopePiece p;
+    p.view_ = data;
+    p.view_size_ = len;
+    return p;
+  }
+
+  bool is_view() const { return view_ != nullptr; }
+
+  size_t size() const { return view_ ? view_size_ : owned_.size(); }
+
+  bool empty() const { return size() == 0; }
+
+  const Char *data() const { return view_ ? view_ : owned_.data(); }
+
+  const Char &operator[](size_t i) const { return data()[i]; }
+
+  // Slicing a view is still a view.
+  RopePiece Slice(size_t pos, size_t len) const {
+    if (view_)
+      return View(view_ + pos, len);
+    return RopePiece(owned_.data() + pos, len);
+  }
+
+  void append(const RopePiece &other) {
+    if (view_ && view_ + view_size_ == other.view_) {
+      view_size_ += other.view_size_;
+      return;
+    }
+    append(other.data(), other.size());
+  }
+
+  void append(const Char *data, size_t len) {
+    MakeOwned();
+    owned_.append(data, len);
+  }
+
+  void push_back(Char c) {
+    MakeOwned();
+    owned_.push_back(c);
+  }
+
+  void insert(size_t pos, Char c) {
+    MakeOwned();
+    owned_.insert(owned_.begin() + pos, c);
+  }
+
+  void insert(size_t pos, const Char *data, size_t len) {
+    MakeOwned();
+    owned_.insert(pos, data, len);
+  }
+
+  void resize(size_t len) {
+    if (view_ && len <= view_size_) {
+      view_size_ = len;
+      return;
+    }
+    MakeOwned();
+    owned_.resize(len);
+  }
+
+private:
+  void MakeOwned() {
+    if (!view_)
+      return;
+    owned_.assign(view_, view_size_);
+    view_ = nullptr;
+    view_size_ = 0;
+  }
+
+  String owned_;
+  const Char *view_;
+  size_t view_size_;
+};
+
+template <typename Char, size_t kMaxPieceSize = 4096,
+          template <typename> class Allocator = NewAllocator>
 class Rope {
 private:
-  using Piece = std::basic_string<Char>;
+  using String = std::basic_string<Char>;
+  using Piece = RopePiece<Char>;
 
   struct Node {
 #ifdef EMCC_DEBUG
@@ -46,10 +139,12 @@ private:
   };
 
   Node *root_;
+  bool splay_on_read_;
+  Allocator<Node> allocator_;
 
   template <typename... Args>
   Node *CreateNode(Args &&...args) {
-    Node *n = new Node(std::forward<Args>(args)...);
+    Node *n = allocator_.New(std::forward<Args>(args)...);
     return n;
   }
 
@@ -112,13 +207,12 @@ private:
     if (cmp.order != 0) {
       return std::make_tuple(node, nullptr);
     }
-    Piece left_piece(node->piece.begin(),
-                     node->piece.begin() + cmp.relative_index);
+    Piece left_piece = node->piece.Slice(0, cmp.relative_index);
     Node *const left = left_piece.empty() ? node->left
                                           : CreateNode(node->left, nullptr,
                                                        std::move(left_piece));
-    Piece right_piece(node->piece.begin() + cmp.relative_index,
-                      node->piece.end());
+    Piece right_piece = node->piece.Slice(
+        cmp.relative_index, node->piece.size() - cmp.relative_index);
     Node *const right =
         right_piece.empty()
             ? node->right
@@ -131,6 +225,9 @@ private:
     if (lhs == nullptr) {
       return rhs;
     }
+    if (rhs == nullptr) {
+      return lhs;
+    }
     Node *const l = Splay(lhs, lhs->size);
     assert(l->right == nullptr);
     Node *const r = Splay(rhs, 0);
@@ -282,7 +379,22 @@ private:
     return {0, index - left_subtree_size};
   }
 
-  void Release(Node *const node) { delete node; }
+  void Release(Node *const node) { allocator_.Delete(node); }
+
+  // Release the whole subtree.
+  void Clear(Node *const node) {
+    std::vector<Node *> worklist;
+    worklist.push_back(node);
+    while (!worklist.empty()) {
+      Node *n = worklist.back();
+      worklist.pop_back();
+      if (n) {
+        worklist.emplace_back(n->left);
+        worklist.emplace_back(n->right);
+      }
+      Release(n);
+    }
+  }
 
   Node *Insert(Node *node, const size_t index, Char c) {
     if (node == nullptr) {
@@ -295,13 +407,16 @@ private:
     node = Splay(node, index);
     auto cmp = Compare(index, node);
     assert(cmp.order >= 0);
+    if (node->piece.size() > kMaxPieceSize) {
+      return InsertIntoView(node, cmp, c);
+    }
     if (node->piece.size() < kMaxPieceSize) {
       if (cmp.order > 0) {
         assert(cmp.relative_index == 0);
         node->piece.push_back(c);
       } else {
         assert(cmp.relative_index < node->piece.size());
-        node->piece.insert(node->piece.begin() + cmp.relative_index, c);
+        node->piece.insert(cmp.relative_index, c);
       }
       node->UpdateSize();
       return node;
@@ -318,58 +433,90 @@ private:
     assert(cmp.order == 0);
     assert(cmp.relative_index < node->piece.size());
     assert(node->piece.size() == kMaxPieceSize);
-    Piece right_piece(node->piece.begin() + kMaxPieceSize / 2,
-                      node->piece.end());
+    Piece right_piece =
+        node->piece.Slice(kMaxPieceSize / 2, kMaxPieceSize - kMaxPieceSize / 2);
     Node *right_subtree = CreateNode(std::move(right_piece));
     right_subtree->right = node->right;
     node->piece.resize(kMaxPieceSize / 2);
     node->right = right_subtree;
     if (cmp.relative_index < kMaxPieceSize / 2) {
-      node->piece.insert(node->piece.begin() + cmp.relative_index, c);
+      node->piece.insert(cmp.relative_index, c);
     } else {
-      right_subtree->piece.insert(right_subtree->piece.begin() +
-                                      (cmp.relative_index - kMaxPieceSize / 2),
-                                  c);
+      right_subtree->piece.insert(cmp.relative_index - kMaxPieceSize / 2, c);
     }
     right_subtree->UpdateSize();
     node->UpdateSize();
     return node;
   }
 
-  Node *FillNode(const Char *data, size_t len) {
-    size_t i = 0;
-    Node *left = nullptr;
-    while (i < len) {
-      Node *node = CreateNode();
-      size_t piece_size = len - i >= kMaxPieceSize ? kMaxPieceSize : len - i;
-      node->piece.append(data + i, piece_size);
-      node->left = left;
+  // Only views can be larger than kMaxPieceSize. Split the view around
+  // index instead of copying it, c is put in a new node.
+  Node *InsertIntoView(Node *node, const CompareResult &cmp, Char c) {
+    assert(node->piece.is_view());
+    Piece p;
+    p.push_back(c);
+    const size_t index =
+        cmp.order > 0 ? node->piece.size() : cmp.relative_index;
+    if (index == 0) {
+      node->left = CreateNode(node->left, nullptr, std::move(p));
       node->UpdateSize();
-      left = node;
-      i += piece_size;
+      return node;
     }
-    assert(i == len);
-    return left;
+    Node *right = node->right;
+    if (index < node->piece.size()) {
+      right = CreateNode(nullptr, right,
+                         node->piece.Slice(index, node->piece.size() - index));
+      node->piece.resize(index);
+    }
+    node->right = CreateNode(nullptr, right, std::move(p));
+    node->UpdateSize();
+    return node;
+  }
+
+  // Build a balanced tree of full pieces in one pass, so that bulk loaded
+  // data doesn't start as a degenerated chain.
+  Node *FillNode(const Char *data, size_t len) {
+    const size_t num_pieces = (len + kMaxPieceSize - 1) / kMaxPieceSize;
+    return FillNode(data, len, 0, num_pieces);
+  }
+
+  Node *FillNode(const Char *data, size_t len, size_t first, size_t last) {
+    if (first >= last)
+      return nullptr;
+    const size_t mid = first + (last - first) / 2;
+    const size_t offset = mid * kMaxPieceSize;
+    Node *node =
+        CreateNode(Piece(data + offset, std::min(kMaxPieceSize, len - offset)));
+    node->left = FillNode(data, len, first, mid);
+    node->right = FillNode(data, len, mid + 1, last);
+    node->UpdateSize();
+    return node;
   }
 
 public:
   static constexpr size_t npos = ~0UL;
-  Rope() : root_(nullptr) {}
+  Rope() : root_(nullptr), splay_on_read_(true) {}
 
-  Rope(const Piece &p) : root_(nullptr) { Append(p); }
+  Rope(const String &s) : root_(nullptr), splay_on_read_(true) { Append(s); }
 
   Rope(const Rope &other) = delete;
 
-  Rope(Rope &&other) : root_(nullptr) { std::swap(root_, other.root_); }
+  Rope(Rope &&other) : root_(nullptr), splay_on_read_(other.splay_on_read_) {
+    std::swap(root_, other.root_);
+    std::swap(allocator_, other.allocator_);
+  }
 
   Rope &swap(Rope &&other) {
     std::swap(root_, other.root_);
+    std::swap(splay_on_read_, other.splay_on_read_);
+    std::swap(allocator_, other.allocator_);
     return *this;
   }
 
   Rope &Concat(Rope &&other) {
     root_ = Concat(root_, other.root_);
     other.root_ = nullptr;
+    allocator_.Absorb(std::move(other.allocator_));
     return *this;
   }
 
@@ -378,10 +525,39 @@ public:
     std::tie(root_, tail) = Split(root_, i);
     Rope r;
     r.root_ = tail;
+    r.splay_on_read_ = splay_on_read_;
+    r.allocator_ = allocator_.Share();
     return std::move(r);
   }
 
+  // Splaying on read favors repeated access of nearby chars, not splaying
+  // keeps the tree intact for concurrent readers and is faster for random
+  // reads of a balanced tree. Splaying is the default since a tree grown by
+  // small edits is a chain that only splaying rebalances, see
+  // RopeBenchmark.AppendedAccessPatterns.
+  void set_splay_on_read(bool splay) { splay_on_read_ = splay; }
+  bool splay_on_read() const { return splay_on_read_; }
+
+  // Like At, but the tree is not modified.
+  Char Peek(size_t index) const {
+    assert(index < size());
+    const Node *node = root_;
+    while (true) {
+      const size_t left_size = node->left ? node->left->size : 0;
+      if (index < left_size) {
+        node = node->left;
+      } else if (index < left_size + node->piece.size()) {
+        return node->piece[index - left_size];
+      } else {
+        index -= left_size + node->piece.size();
+        node = node->right;
+      }
+    }
+  }
+
   Char At(const size_t index) {
+    if (!splay_on_read_)
+      return Peek(index);
     assert(root_);
     assert(index < root_->size);
     root_ = Splay(root_, index);
@@ -400,8 +576,33 @@ public:
     return res;
   }
 
-  size_t Insert(const size_t index, const Piece &piece) {
-    return Insert(index, piece.begin(), piece.end());
+  // Splice data into the rope as a balanced subtree. Data fitting in the
+  // piece at index is inserted in place, so that small edits do not add tiny
+  // pieces.
+  size_t Insert(const size_t index, const Char *data, size_t len) {
+    if (len == 0)
+      return 0;
+    if (root_ && len < kMaxPieceSize) {
+      root_ = Splay(root_, std::min(index, root_->size));
+      auto cmp = Compare(std::min(index, root_->size), root_);
+      assert(cmp.order >= 0);
+      if (root_->piece.size() + len <= kMaxPieceSize) {
+        if (cmp.order > 0)
+          root_->piece.append(data, len);
+        else
+          root_->piece.insert(cmp.relative_index, data, len);
+        root_->UpdateSize();
+        return len;
+      }
+    }
+    Node *tail = nullptr;
+    std::tie(root_, tail) = Split(root_, index);
+    root_ = Concat(Concat(root_, FillNode(data, len)), tail);
+    return len;
+  }
+
+  size_t Insert(const size_t index, const String &s) {
+    return Insert(index, s.data(), s.size());
   }
 
   bool Insert(const size_t index, Char c) {
@@ -423,9 +624,10 @@ public:
     assert(to);
     size_t num_erased = to->size;
     if (erased) {
-      erased->root_ = Concat(erased->root_, to);
+      erased->root_ = erased->Concat(erased->root_, to);
+      erased->allocator_.Absorb(allocator_.Share());
     } else {
-      Release(to);
+      Clear(to);
     }
     if (tail == nullptr) {
       return num_erased;
@@ -457,40 +659,89 @@ public:
     return count;
   }
 
-  void Append(const Piece &piece) { return Append(piece.data(), piece.size()); }
+  void Append(const String &s) { return Append(s.data(), s.size()); }
 
-  Rope Copy(size_t offset, size_t len) {
+  // Append data by reference rather than copying it. data must outlive the
+  // rope, pieces referring to it are copied on write.
+  void AppendView(const Char *data, size_t len) {
+    if (len == 0)
+      return;
+    root_ = Concat(root_, CreateNode(Piece::View(data, len)));
+  }
+
+  Rope Copy(size_t offset, size_t len) const {
     Rope result;
+    Visit(offset, len, [&result](const Char *data, size_t n) {
+      result.Append(data, n);
+    });
+    return result;
+  }
+
+  // Calls f(data, n) for each contiguous span of [offset, offset + len) in
+  // order. Unlike At, the tree is not splayed. Returns number of visited
+  // chars.
+  template <typename F>
+  size_t Visit(size_t offset, size_t len, F &&f) const {
     if (offset >= size())
-      return result;
+      return 0;
     len = std::min(len, size() - offset);
-    assert(root_);
-    while (len) {
-      assert(offset < size());
-      size_t num_copied = 0;
-      root_ = Splay(root_, offset);
-      auto cmp = Compare(offset, root_);
-      assert(cmp.order == 0);
-      num_copied = std::min(root_->piece.size() - cmp.relative_index, len);
-      result.Append(root_->piece.data() + cmp.relative_index, num_copied);
-      len -= num_copied;
-      offset += num_copied;
+    // Ancestors whose pieces are not visited yet.
+    std::vector<const Node *> stack;
+    const Node *node = root_;
+    while (true) {
+      assert(node);
+      const size_t left_size = node->left ? node->left->size : 0;
+      if (offset < left_size) {
+        stack.emplace_back(node);
+        node = node->left;
+      } else if (offset < left_size + node->piece.size()) {
+        offset -= left_size;
+        break;
+      } else {
+        offset -= left_size + node->piece.size();
+        node = node->right;
+      }
+    }
+    size_t visited = 0;
+    while (true) {
+      const size_t n = std::min(node->piece.size() - offset, len - visited);
+      if (n)
+        f(node->piece.data() + offset, n);
+      visited += n;
+      offset = 0;
+      if (visited == len)
+        return visited;
+      if (node->right) {
+        node = node->right;
+        while (node->left) {
+          stack.emplace_back(node);
+          node = node->left;
+        }
+      } else {
+        assert(!stack.empty());
+        node = stack.back();
+        stack.pop_back();
+      }
     }
-    return result;
+  }
+
+  // Copy [offset, offset + len) to out. Returns number of copied chars.
+  size_t Read(size_t offset, size_t len, Char *out) const {
+    return Visit(offset, len, [&out](const Char *data, size_t n) {
+      out = std::copy(data, data + n, out);
+    });
+  }
+
+  size_t Read(size_t offset, size_t len, String &out) const {
+    return Visit(offset, len, [&out](const Char *data, size_t n) {
+      out.append(data, n);
+    });
   }
 
   void clear() {
-    std::vector<Node *> worklist;
-    worklist.push_back(root_);
-    while (!worklist.empty()) {
-      Node *n = worklist.back();
-      worklist.pop_back();
-      if (n) {
-        worklist.emplace_back(n->left);
-        worklist.emplace_back(n->right);
-      }
-      delete n;
-    }
+    // Nodes needn't be visited if they can be freed at once.
+    if (!std::is_trivially_destructible_v<Node> || !allocator_.Reset())
+      Clear(root_);
     root_ = nullptr;
   }
 
@@ -518,8 +769,8 @@ inline std::ostream &operator<<(std::ostream &out, Rope<char> &rope) {
   return out;
 }
 
-template <size_t N>
-inline bool operator==(Rope<char, N> &rope, const std::string &s) {
+template <size_t N, template <typename> class A>
+inline bool operator==(Rope<char, N, A> &rope, const std::string &s) {
   if (rope.size() != s.size())
     return false;
   for (size_t i = 0; i != rope.size(); ++i)
@@ -528,8 +779,8 @@ inline bool operator==(Rope<char, N> &rope, const std::string &s) {
   return true;
 }
 
-template <size_t N>
-inline bool operator==(Rope<char, N> &rope, const char *s) {
+template <size_t N, template <typename> class A>
+inline bool operator==(Rope<char, N, A> &rope, const char *s) {
   if (rope.size() != ::strlen(s))
     return false;
   for (size_t i = 0; i != rope.size(); ++i)
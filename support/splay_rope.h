@@ -2,9 +2,14 @@
 
 #pragma once
 
+#include "support/node_allocator.h"
+
 #include <cassert>
 #include <iostream>
+#include <iterator>
 #include <stddef.h>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -47,25 +52,37 @@ struct DefaultPiece {
   static void UpdateNode(SplayRopeNode<T> *node) {}
 };
 
-template <typename Piece = DefaultPiece>
+template <typename Piece = DefaultPiece,
+          template <typename> class Allocator = NewAllocator>
 class SplayRope {
 public:
   static constexpr size_t npos = ~0UL;
   using PieceTy = Piece;
   using Node = SplayRopeNode<Piece>;
 
-  SplayRope() : root_(nullptr) {}
+  SplayRope() : root_(nullptr), splay_on_read_(true) {}
   SplayRope(const SplayRope &) = delete;
-  SplayRope(SplayRope &&other) : root_(nullptr) {
+  SplayRope(SplayRope &&other) : root_(nullptr), splay_on_read_(true) {
     std::swap(root_, other.root_);
+    std::swap(splay_on_read_, other.splay_on_read_);
+    std::swap(allocator_, other.allocator_);
   }
   SplayRope &operator=(SplayRope &&other) {
     std::swap(root_, other.root_);
+    std::swap(splay_on_read_, other.splay_on_read_);
+    std::swap(allocator_, other.allocator_);
     return *this;
   }
+  // Whether read only lookups of derived classes splay the tree. Splaying
+  // favors repeated access of nearby pieces, not splaying keeps the tree
+  // intact for concurrent readers. See Rope::set_splay_on_read for why
+  // splaying is the default.
+  void set_splay_on_read(bool splay) { splay_on_read_ = splay; }
+  bool splay_on_read() const { return splay_on_read_; }
   void clear() { Clear(); }
   size_t size() const { return root_ ? root_->size : 0; }
   bool empty() const { return size() == 0; }
+  // The piece is splayed to the root, call UpdateRoot after modifying it.
   Piece &At(size_t i) {
     assert(i < size());
     Node *const node = AtOrNull(i);
@@ -73,6 +90,22 @@ public:
     node->update();
     return node->piece;
   }
+  void UpdateRoot() {
+    if (root_)
+      root_->update();
+  }
+  // Like At, but the tree is not modified.
+  const Piece &Peek(size_t i) const {
+    assert(i < size());
+    const Node *node = root_;
+    while (true) {
+      auto cmp = Compare(i, node);
+      if (cmp.order == 0)
+        return node->piece;
+      i = cmp.relative_index;
+      node = cmp.order < 0 ? node->left : node->right;
+    }
+  }
   bool Remove(size_t i) {
     Node *const node = AtOrNull(i);
     if (!node)
@@ -124,12 +157,33 @@ public:
   SplayRope &Append(Args &&...args) {
     return Insert(size(), std::forward<Args>(args)...);
   }
+  // Append pieces constructed from [begin, end) as a balanced subtree, which
+  // is much cheaper than appending them one by one.
+  template <typename Iterator>
+  SplayRope &AppendRange(Iterator begin, Iterator end) {
+    Node *const subtree = Build(begin, std::distance(begin, end));
+    root_ = Concat(root_, subtree);
+    return *this;
+  }
+  // Like AppendRange, but pieces are inserted before the i-th piece.
+  template <typename Iterator>
+  SplayRope &InsertRange(size_t i, Iterator begin, Iterator end) {
+    Node *const subtree = Build(begin, std::distance(begin, end));
+    Node *tail = nullptr;
+    std::tie(root_, tail) = Split(root_, i);
+    root_ = Concat(Concat(root_, subtree), tail);
+    return *this;
+  }
   ~SplayRope() { Clear(); }
 
 #ifdef EMCC_DEBUG
   size_t height() const { return GetHeight(root_); }
 #endif
 
+protected:
+  const Node *root() const { return root_; }
+  Node *root() { return root_; }
+
 private:
 #ifdef EMCC_DEBUG
   size_t GetHeight(Node *const node) const { return node ? node->height : 0; }
@@ -146,6 +200,44 @@ private:
     return {1, index - (left_size + mid_size)};
   }
 
+  template <typename Iterator>
+  Node *Build(Iterator begin, size_t n) {
+    if (n == 0)
+      return nullptr;
+    const size_t mid = n / 2;
+    Node *const left = Build(begin, mid);
+    Iterator it = std::next(begin, mid);
+    Node *const node = CreateNode(*it);
+    node->left = left;
+    node->right = Build(std::next(it), n - mid - 1);
+    node->update();
+    return node;
+  }
+
+  Node *Concat(Node *const lhs, Node *const rhs) {
+    if (lhs == nullptr)
+      return rhs;
+    if (rhs == nullptr)
+      return lhs;
+    Node *const node = Splay(lhs, lhs->size - 1);
+    assert(node->right == nullptr);
+    node->right = rhs;
+    node->update();
+    return node;
+  }
+
+  // Split into first index pieces and the rest.
+  std::pair<Node *, Node *> Split(Node *const node, size_t index) {
+    if (node == nullptr || index >= node->size)
+      return {node, nullptr};
+    Node *const right = Splay(node, index);
+    assert(right->left_size() == index);
+    Node *const left = right->left;
+    right->left = nullptr;
+    right->update();
+    return {left, right};
+  }
+
   Node *AtOrNull(size_t i) {
     root_ = Splay(root_, i);
     if (!root_)
@@ -189,7 +281,7 @@ private:
 
   template <typename... Args>
   Node *CreateNode(Args &&...args) {
-    Node *n = new Node(std::forward<Args>(args)...);
+    Node *n = allocator_.New(std::forward<Args>(args)...);
     n->update();
     return n;
   }
@@ -214,11 +306,18 @@ private:
     return node;
   }
 
-  void Release(Node *const node) { delete node; }
+  void Release(Node *const node) { allocator_.Delete(node); }
 
   void Clear() {
+    // Nodes needn't be visited if they can be freed at once.
+    if (!std::is_trivially_destructible_v<Node> || !allocator_.Reset())
+      Clear(root_);
+    root_ = nullptr;
+  }
+
+  void Clear(Node *const node) {
     std::vector<Node *> worklist;
-    worklist.push_back(root_);
+    worklist.push_back(node);
     while (!worklist.empty()) {
       Node *n = worklist.back();
       worklist.pop_back();
@@ -228,7 +327,6 @@ private:
       }
       Release(n);
     }
-    root_ = nullptr;
   }
 
   Node *Splay(Node *node, const size_t index) {
@@ -349,6 +447,44 @@ private:
   }
 
   Node *root_;
+  bool splay_on_read_;
+  Allocator<Node> allocator_;
 };
 
+template <typename Piece, template <typename> class Allocator>
+SplayRope<Piece, Allocator> &
+SplayRope<Piece, Allocator>::Concat(SplayRope &&other) {
+  root_ = Concat(root_, other.root_);
+  other.root_ = nullptr;
+  allocator_.Absorb(std::move(other.allocator_));
+  return *this;
+}
+
+template <typename Piece, template <typename> class Allocator>
+SplayRope<Piece, Allocator> SplayRope<Piece, Allocator>::Split(size_t index) {
+  SplayRope tail;
+  tail.splay_on_read_ = splay_on_read_;
+  tail.allocator_ = allocator_.Share();
+  std::tie(root_, tail.root_) = Split(root_, index);
+  return tail;
+}
+
+template <typename Piece, template <typename> class Allocator>
+bool SplayRope<Piece, Allocator>::Erase(size_t index, size_t len,
+                                        SplayRope *erased) {
+  Node *middle = nullptr, *tail = nullptr;
+  std::tie(root_, middle) = Split(root_, index);
+  std::tie(middle, tail) = Split(middle, len);
+  root_ = Concat(root_, tail);
+  if (middle == nullptr)
+    return false;
+  if (erased) {
+    erased->root_ = erased->Concat(erased->root_, middle);
+    erased->allocator_.Absorb(allocator_.Share());
+  } else {
+    Clear(middle);
+  }
+  return true;
+}
+
 } // namespace emcc
@@ -0,0 +1,77 @@
+// Copyright (c) 2021 Kai Luo <gluokai@gmail.com>. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace emcc {
+
+// A fixed size thread pool, tasks are run in FIFO order.
+class ThreadPool {
+public:
+  explicit ThreadPool(size_t num_threads) : stopping_(false) {
+    for (size_t i = 0; i < std::max(num_threads, 1UL); ++i)
+      workers_.emplace_back([this] { Work(); });
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+
+  size_t size() const { return workers_.size(); }
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> Submit(F &&f) {
+    using R = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> result = task->get_future();
+    {
+      std::unique_lock<std::mutex> l(mu_);
+      tasks_.emplace_back([task] { (*task)(); });
+    }
+    cv_.notify_one();
+    return result;
+  }
+
+  // Pending tasks are still run before workers exit.
+  ~ThreadPool() {
+    {
+      std::unique_lock<std::mutex> l(mu_);
+      stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto &worker : workers_)
+      worker.join();
+  }
+
+private:
+  void Work() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> l(mu_);
+        cv_.wait(l, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty())
+          return;
+        task = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      task();
+    }
+  }
+
+  bool stopping_;
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace emcc
@@ -75,6 +75,36 @@ inline bool DecodeUTF8(const std::string &s, std::vector<uint32_t> &result) {
   return state == UTF8_ACCEPT;
 }
 
+constexpr uint32_t kReplacementCharacter = 0xFFFD;
+
+// Write codepoint to out, which must have room for 4 bytes. Surrogates and
+// codepoints beyond U+10FFFF are written as U+FFFD. Returns number of
+// written bytes.
+constexpr size_t EncodeUTF8(uint32_t codepoint, char *out) {
+  if (codepoint < 0x80) {
+    out[0] = codepoint;
+    return 1;
+  }
+  if (codepoint < 0x800) {
+    out[0] = 0xC0 | (codepoint >> 6);
+    out[1] = 0x80 | (codepoint & 0x3F);
+    return 2;
+  }
+  if ((codepoint >= 0xD800 && codepoint < 0xE000) || codepoint > 0x10FFFF)
+    codepoint = kReplacementCharacter;
+  if (codepoint < 0x10000) {
+    out[0] = 0xE0 | (codepoint >> 12);
+    out[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+    out[2] = 0x80 | (codepoint & 0x3F);
+    return 3;
+  }
+  out[0] = 0xF0 | (codepoint >> 18);
+  out[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+  out[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+  out[3] = 0x80 | (codepoint & 0x3F);
+  return 4;
+}
+
 class UTF8Decoder {
 public:
   UTF8Decoder() : state_(UTF8_ACCEPT) {}
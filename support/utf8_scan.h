@@ -0,0 +1,350 @@
+#pragma once
+
+#include "support/byte_scan.h"
+#include "support/utf8.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace emcc {
+
+namespace detail {
+
+// Length of the leading run of ASCII bytes.
+inline size_t CountASCIIScalar(const char *data, size_t len) {
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    if (word & 0x8080808080808080UL)
+      break;
+  }
+  while (i < len && !(data[i] & 0x80))
+    ++i;
+  return i;
+}
+
+#ifdef EMCC_X86_SIMD
+inline size_t CountASCIISSE2(const char *data, size_t len) {
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    uint32_t mask = _mm_movemask_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + CountASCIIScalar(data + i, len - i);
+}
+
+__attribute__((target("avx2"))) inline size_t
+CountASCIIAVX2(const char *data, size_t len) {
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    uint32_t mask = _mm256_movemask_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)));
+    if (mask)
+      return i + __builtin_ctz(mask);
+  }
+  return i + CountASCIISSE2(data + i, len - i);
+}
+
+// Multi-byte sequences are checked by looking up the high nibble and low
+// nibble of each byte and the high nibble of the byte after it in three
+// tables, an error is found if their AND is not zero. Lengths are checked
+// by matching expected continuations against the leads 2 and 3 bytes back.
+// See Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per
+// Byte".
+namespace utf8 {
+// 11______ 0_______ or 11______ 11______
+constexpr uint8_t kTooShort = 1 << 0;
+// 0_______ 10______
+constexpr uint8_t kTooLong = 1 << 1;
+// 11100000 100_____
+constexpr uint8_t kOverlong3 = 1 << 2;
+// 11110100 1001____ and above
+constexpr uint8_t kTooLarge = 1 << 3;
+// 11101101 101_____
+constexpr uint8_t kSurrogate = 1 << 4;
+// 1100000_ 10______
+constexpr uint8_t kOverlong2 = 1 << 5;
+// 11110101 1000____ and above, shares the bit with kOverlong4.
+constexpr uint8_t kTooLarge1000 = 1 << 6;
+// 11110000 1000____
+constexpr uint8_t kOverlong4 = 1 << 6;
+// 10______ 10______
+constexpr uint8_t kTwoConts = 1 << 7;
+constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+alignas(16) constexpr uint8_t kByte1High[16] = {
+    kTooLong,
+    kTooLong,
+    kTooLong,
+    kTooLong,
+    kTooLong,
+    kTooLong,
+    kTooLong,
+    kTooLong,
+    kTwoConts,
+    kTwoConts,
+    kTwoConts,
+    kTwoConts,
+    kTooShort | kOverlong2,
+    kTooShort,
+    kTooShort | kOverlong3 | kSurrogate,
+    kTooShort | kTooLarge | kTooLarge1000 | kOverlong4,
+};
+
+alignas(16) constexpr uint8_t kByte1Low[16] = {
+    kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+    kCarry | kOverlong2,
+    kCarry,
+    kCarry,
+    kCarry | kTooLarge,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000 | kSurrogate,
+    kCarry | kTooLarge | kTooLarge1000,
+    kCarry | kTooLarge | kTooLarge1000,
+};
+
+alignas(16) constexpr uint8_t kByte2High[16] = {
+    kTooShort,
+    kTooShort,
+    kTooShort,
+    kTooShort,
+    kTooShort,
+    kTooShort,
+    kTooShort,
+    kTooShort,
+    kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge1000 | kOverlong4,
+    kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge,
+    kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+    kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge,
+    kTooShort,
+    kTooShort,
+    kTooShort,
+    kTooShort,
+};
+
+// Non zero in the last 3 bytes if a sequence is cut at the end of a block.
+alignas(32) constexpr uint8_t kIncompleteMax[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+} // namespace utf8
+
+// Start of the rune which may be cut at end, blocks are validated up to it.
+inline size_t ResumePoint(const char *data, size_t end) {
+  for (size_t k = 1; k <= 3 && k <= end; ++k) {
+    uint8_t byte = data[end - k];
+    if ((byte & 0xC0) != 0x80)
+      return byte >= 0xC0 ? end - k : end;
+  }
+  return end;
+}
+
+// Validate whole blocks of data, which must start at a rune boundary.
+// Returns false if an error is found, otherwise validated is set to where
+// the scalar decoder should resume, which is the start of the last rune
+// that may be cut at the end of the last block.
+__attribute__((target("ssse3"))) inline bool
+ValidateUTF8SSSE3(const char *data, size_t len, size_t &validated) {
+  const __m128i byte1_high = _mm_load_si128(
+      reinterpret_cast<const __m128i *>(utf8::kByte1High));
+  const __m128i byte1_low =
+      _mm_load_si128(reinterpret_cast<const __m128i *>(utf8::kByte1Low));
+  const __m128i byte2_high = _mm_load_si128(
+      reinterpret_cast<const __m128i *>(utf8::kByte2High));
+  const __m128i incomplete_max = _mm_load_si128(
+      reinterpret_cast<const __m128i *>(utf8::kIncompleteMax + 16));
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  __m128i prev = _mm_setzero_si128(), error = _mm_setzero_si128(),
+          prev_incomplete = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i input =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+    if (!_mm_movemask_epi8(input)) {
+      error = _mm_or_si128(error, prev_incomplete);
+      continue;
+    }
+    __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+    __m128i special = _mm_and_si128(
+        _mm_and_si128(
+            _mm_shuffle_epi8(byte1_high,
+                             _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+            _mm_shuffle_epi8(byte1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte2_high,
+                         _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+    __m128i prev2 = _mm_alignr_epi8(input, prev, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, prev, 13);
+    __m128i must_continue = _mm_and_si128(
+        _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(0xE0 - 0x80)),
+                     _mm_subs_epu8(prev3, _mm_set1_epi8(0xF0 - 0x80))),
+        _mm_set1_epi8(0x80));
+    error = _mm_or_si128(error, _mm_xor_si128(must_continue, special));
+    prev_incomplete = _mm_subs_epu8(input, incomplete_max);
+    prev = input;
+  }
+  if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF)
+    return false;
+  validated = ResumePoint(data, i);
+  return true;
+}
+
+__attribute__((target("avx2"))) inline bool
+ValidateUTF8AVX2(const char *data, size_t len, size_t &validated) {
+  const __m256i byte1_high = _mm256_broadcastsi128_si256(_mm_load_si128(
+      reinterpret_cast<const __m128i *>(utf8::kByte1High)));
+  const __m256i byte1_low = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i *>(utf8::kByte1Low)));
+  const __m256i byte2_high = _mm256_broadcastsi128_si256(_mm_load_si128(
+      reinterpret_cast<const __m128i *>(utf8::kByte2High)));
+  const __m256i incomplete_max = _mm256_load_si256(
+      reinterpret_cast<const __m256i *>(utf8::kIncompleteMax));
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  __m256i prev = _mm256_setzero_si256(), error = _mm256_setzero_si256(),
+          prev_incomplete = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i input =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+    if (!_mm256_movemask_epi8(input)) {
+      error = _mm256_or_si256(error, prev_incomplete);
+      continue;
+    }
+    // Lanes of prev1 are input shifted by one byte across the 128 bit lanes.
+    __m256i carried = _mm256_permute2x128_si256(prev, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, carried, 15);
+    __m256i special = _mm256_and_si256(
+        _mm256_and_si256(
+            _mm256_shuffle_epi8(
+                byte1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4),
+                                             nibble)),
+            _mm256_shuffle_epi8(byte1_low, _mm256_and_si256(prev1, nibble))),
+        _mm256_shuffle_epi8(
+            byte2_high,
+            _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+    __m256i prev2 = _mm256_alignr_epi8(input, carried, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, carried, 13);
+    __m256i must_continue = _mm256_and_si256(
+        _mm256_or_si256(
+            _mm256_subs_epu8(prev2, _mm256_set1_epi8(0xE0 - 0x80)),
+            _mm256_subs_epu8(prev3, _mm256_set1_epi8(0xF0 - 0x80))),
+        _mm256_set1_epi8(0x80));
+    error = _mm256_or_si256(error, _mm256_xor_si256(must_continue, special));
+    prev_incomplete = _mm256_subs_epu8(input, incomplete_max);
+    prev = input;
+  }
+  if (!_mm256_testz_si256(error, error))
+    return false;
+  validated = ResumePoint(data, i);
+  return true;
+}
+
+inline bool HasSSSE3() {
+  static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+  return has_ssse3;
+}
+#endif
+
+inline size_t CountASCII(const char *data, size_t len) {
+#ifdef EMCC_X86_SIMD
+  if (HasAVX2())
+    return CountASCIIAVX2(data, len);
+  return CountASCIISSE2(data, len);
+#else
+  return CountASCIIScalar(data, len);
+#endif
+}
+
+// See ValidateUTF8SSSE3. Returns true with validated set to 0 if no kernel
+// applies.
+inline bool ValidateUTF8Blocks(const char *data, size_t len,
+                               size_t &validated) {
+  validated = 0;
+#ifdef EMCC_X86_SIMD
+  if (HasAVX2())
+    return ValidateUTF8AVX2(data, len, validated);
+  if (HasSSSE3())
+    return ValidateUTF8SSSE3(data, len, validated);
+#endif
+  return true;
+}
+
+} // namespace detail
+
+// Data read in pieces is cut at ResumePoint, so that no rune is split.
+using detail::ResumePoint;
+
+// Validate UTF-8 fed in pieces, e.g. leaves of a rope. Runes may be split
+// across pieces.
+class UTF8Validator {
+public:
+  void Feed(const char *data, size_t len) {
+    size_t i = 0;
+    // Finish the rune cut by the last piece.
+    while (i < len && state_ != UTF8_ACCEPT && state_ != UTF8_REJECT)
+      DecodeUTF8(&state_, &cp_, data[i++]);
+    if (state_ == UTF8_REJECT)
+      return;
+    size_t validated;
+    if (!detail::ValidateUTF8Blocks(data + i, len - i, validated)) {
+      state_ = UTF8_REJECT;
+      return;
+    }
+    i += validated;
+    while (i < len && state_ != UTF8_REJECT) {
+      if (state_ == UTF8_ACCEPT)
+        i += detail::CountASCIIScalar(data + i, len - i);
+      if (i < len)
+        DecodeUTF8(&state_, &cp_, data[i++]);
+    }
+  }
+
+  // Whether all data fed so far is valid, and no rune is left unfinished.
+  bool ok() const { return state_ == UTF8_ACCEPT; }
+
+private:
+  uint32_t state_ = UTF8_ACCEPT, cp_ = 0;
+};
+
+inline bool IsValidUTF8(const char *data, size_t len) {
+  UTF8Validator validator;
+  validator.Feed(data, len);
+  return validator.ok();
+}
+
+// Calls f(i, codepoint) for every rune starting at data[i], in order. Runs of
+// ASCII bytes skip the DFA. Decoding stops at the first invalid byte, like
+// DecodeUTF8 does. Returns false if data is not valid UTF-8.
+template <typename F>
+inline bool DecodeUTF8(const char *data, size_t len, F &&f) {
+  uint32_t state = UTF8_ACCEPT, cp = 0;
+  size_t start = 0;
+  for (size_t i = 0; i < len;) {
+    if (state == UTF8_ACCEPT && !(data[i] & 0x80)) {
+      size_t n = detail::CountASCII(data + i, len - i);
+      for (size_t end = i + n; i < end; ++i)
+        f(i, uint32_t(data[i]));
+      continue;
+    }
+    if (state == UTF8_ACCEPT)
+      start = i;
+    if (DecodeUTF8(&state, &cp, data[i++]))
+      f(start, cp);
+    else if (state == UTF8_REJECT)
+      return false;
+  }
+  return state == UTF8_ACCEPT;
+}
+
+} // namespace emcc
@@ -63,6 +63,7 @@
 // the LICENSE file.
 
 #include "support/wcwidth.h"
+#include "support/wcwidth_table.h"
 
 #include <wchar.h>
 
@@ -128,7 +129,7 @@ int bisearch(wchar_t ucs, const struct interval *table, int max) {
  * in ISO 10646.
  */
 
-int wchar_width(wchar_t ucs) {
+int wchar_width_bisearch(wchar_t ucs) {
   /* sorted list of non-overlapping intervals of non-spacing characters */
   /* generated by "uniset +cat=Me +cat=Mn +cat=Cf -00AD +1160-11FF +200B c" */
   static const struct interval combining[] = {
@@ -218,7 +219,7 @@ int wchar_width(wchar_t ucs) {
  * the traditional terminal character-width behaviour. It is not
  * otherwise recommended for general use.
  */
-int wchar_width_cjk(wchar_t ucs) {
+int wchar_width_cjk_bisearch(wchar_t ucs) {
   /* sorted list of non-overlapping intervals of East Asian Ambiguous
    * characters, generated by "uniset +WIDTH-A -cat=Me -cat=Mn -cat=Cf c" */
   static const struct interval ambiguous[] = {
@@ -279,7 +280,33 @@ int wchar_width_cjk(wchar_t ucs) {
   if (bisearch(ucs, ambiguous, sizeof(ambiguous) / sizeof(struct interval) - 1))
     return 2;
 
-  return wchar_width(ucs);
+  return wchar_width_bisearch(ucs);
+}
+
+namespace {
+// Widths of both variants are packed in an entry of the table, see
+// tools/wcwidth_table_gen.cc.
+int LookupWidthTable(wchar_t ucs, int shift) {
+  if (ucs < 0)
+    return -1;
+  if (ucs >= kWidthTableLimit)
+    return 1;
+  uint8_t block = kWidthTableStage1[ucs >> kWidthTableBlockBits];
+  uint8_t entry = kWidthTableStage2[block][ucs & kWidthTableBlockMask];
+  return ((entry >> shift) & 3) - 1;
+}
+} // namespace
+
+int wchar_width(wchar_t ucs) {
+  if (ucs >= 0x20 && ucs < 0x7f)
+    return 1;
+  return LookupWidthTable(ucs, 0);
+}
+
+int wchar_width_cjk(wchar_t ucs) {
+  if (ucs >= 0x20 && ucs < 0x7f)
+    return 1;
+  return LookupWidthTable(ucs, 2);
 }
 
 int wstring_width(const std::wstring &text) {
@@ -6,7 +6,12 @@ namespace emcc {
 
 int wstring_width_cjk(const std::wstring &text);
 int wstring_width(const std::wstring &text);
+// Looked up in tables generated from the *_bisearch variants.
 int wchar_width_cjk(wchar_t ucs);
 int wchar_width(wchar_t ucs);
+// Search intervals of combining and ambiguous characters. Slower, but they
+// are the source of the tables.
+int wchar_width_cjk_bisearch(wchar_t ucs);
+int wchar_width_bisearch(wchar_t ucs);
 
 } // namespace emcc
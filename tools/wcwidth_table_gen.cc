@@ -0,0 +1,68 @@
+// Generate support/wcwidth_table.h, run as
+//   wcwidth_table_gen > support/wcwidth_table.h
+//
+// Code points are split into blocks of 1 << kBlockBits. Stage 1 maps a
+// block to a row of stage 2, identical blocks share the row. An entry of
+// stage 2 packs wchar_width + 1 in bits [0, 2) and wchar_width_cjk + 1 in
+// bits [2, 4).
+
+#include "support/wcwidth.h"
+
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace {
+
+constexpr int kBlockBits = 8;
+constexpr int kBlockSize = 1 << kBlockBits;
+constexpr wchar_t kLimit = 0x110000;
+
+} // namespace
+
+int main() {
+  using namespace emcc;
+  using Block = std::vector<uint8_t>;
+  std::map<Block, size_t> rows;
+  std::vector<const Block *> stage2;
+  std::vector<size_t> stage1;
+  for (wchar_t start = 0; start < kLimit; start += kBlockSize) {
+    Block block(kBlockSize);
+    for (int i = 0; i < kBlockSize; ++i) {
+      int width = wchar_width_bisearch(start + i);
+      int width_cjk = wchar_width_cjk_bisearch(start + i);
+      block[i] = (width + 1) | ((width_cjk + 1) << 2);
+    }
+    auto it = rows.emplace(std::move(block), stage2.size()).first;
+    if (it->second == stage2.size())
+      stage2.push_back(&it->first);
+    stage1.push_back(it->second);
+  }
+  if (stage2.size() > 256) {
+    fprintf(stderr, "Too many rows for uint8_t: %zu\n", stage2.size());
+    return 1;
+  }
+  printf("// Generated by tools/wcwidth_table_gen.cc, do not edit.\n\n");
+  printf("#pragma once\n\n");
+  printf("#include <stdint.h>\n\n");
+  printf("namespace emcc {\n\n");
+  printf("constexpr int kWidthTableBlockBits = %d;\n", kBlockBits);
+  printf("constexpr int kWidthTableBlockMask = %d;\n", kBlockSize - 1);
+  printf("constexpr wchar_t kWidthTableLimit = 0x%X;\n\n", kLimit);
+  printf("constexpr uint8_t kWidthTableStage1[%zu] = {", stage1.size());
+  for (size_t i = 0; i < stage1.size(); ++i)
+    printf("%s%zu,", i % 16 ? " " : "\n    ", stage1[i]);
+  printf("\n};\n\n");
+  printf("constexpr uint8_t kWidthTableStage2[%zu][%d] = {\n", stage2.size(),
+         kBlockSize);
+  for (const Block *block : stage2) {
+    printf("    {");
+    for (int i = 0; i < kBlockSize; ++i)
+      printf("%s0x%02X,", i % 12 ? " " : "\n        ", (*block)[i]);
+    printf("\n    },\n");
+  }
+  printf("};\n\n");
+  printf("} // namespace emcc\n");
+  return 0;
+}
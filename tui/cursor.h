@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cassert>
+#include <stddef.h>
 
 namespace emcc::tui {
 
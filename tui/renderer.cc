@@ -1,9 +1,6 @@
 #include "tui/renderer.h"
 
-#include <codecvt>
-#include <locale>
 #include <string>
-#include <wchar.h>
 
 namespace emcc::tui {
 
@@ -25,30 +22,27 @@ void RenderBufferViewWithNCurses(emcc::editor::BufferView &view, WINDOW *window,
   wrefresh(window);
 }
 
-static std::string wstring_to_string(const std::wstring &s) {
-  std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
-  return converter.to_bytes(s);
-}
-
 void RenderBufferView(emcc::editor::BufferView &view,
                       emcc::tui::ANSITerminal &vt, int height, int width) {
-  vt.Clear();
+  Screen screen(height, width);
+  RenderBufferView(view, screen, vt);
+}
+
+void RenderBufferView(emcc::editor::BufferView &view, Screen &screen,
+                      emcc::tui::ANSITerminal &vt) {
+  screen.Clear();
   int y = 0;
   for (auto row : emcc::make_range(view.row_begin(), view.row_end())) {
+    if (y >= screen.height())
+      break;
     int x = 0;
     for (auto &cv : row) {
-      std::wstring ws;
-      ws.push_back(cv.rune);
-      std::string s(wstring_to_string(ws));
-      vt.MoveCursor({y, x});
-      vt.Put(s);
+      screen.Put({y, x}, cv.rune, cv.width);
       x += cv.length();
     }
     ++y;
-    if (y >= height)
-      break;
   }
-  vt.Refresh();
+  screen.Refresh(vt);
 }
 
 } // namespace emcc::tui
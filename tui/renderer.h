@@ -5,6 +5,7 @@
 
 #include "editor/buffer_view.h"
 #include "tui/cursor.h"
+#include "tui/screen.h"
 #include "tui/terminal.h"
 
 #include <ncurses.h>
@@ -12,9 +13,14 @@
 
 namespace emcc::tui {
 
+// Repaint the whole terminal.
 void RenderBufferView(emcc::editor::BufferView &view,
                       emcc::tui::ANSITerminal &vt, int height, int width);
 
+// Only changes since the last frame on screen are sent.
+void RenderBufferView(emcc::editor::BufferView &view, Screen &screen,
+                      emcc::tui::ANSITerminal &vt);
+
 void RenderBufferViewWithNCurses(emcc::editor::BufferView &view, WINDOW *window,
                                  int height, int width);
 
@@ -0,0 +1,169 @@
+#include "tui/screen.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace emcc::tui {
+
+// Sending a few unchanged cells is cheaper than moving the cursor over them.
+static constexpr int kMaxGap = 4;
+
+Screen::Screen(int height, int width)
+    : height_(0), width_(0), invalid_(true), cursor_(-1, 0), target_(-1, 0) {
+  Resize(height, width);
+}
+
+void Screen::Resize(int height, int width) {
+  height_ = std::max(height, 0);
+  width_ = std::max(width, 0);
+  front_.assign(height_ * width_, Cell());
+  back_.assign(height_ * width_, Cell());
+  front_hashes_.resize(height_);
+  back_hashes_.resize(height_);
+  invalid_ = true;
+}
+
+void Screen::Clear() { std::fill(back_.begin(), back_.end(), Cell()); }
+
+bool Screen::Put(Cursor c, uint32_t rune, int width) {
+  if (width != 1 && width != 2)
+    return false;
+  if (c.y < 0 || c.y >= height_ || c.x < 0 || c.x + width > width_)
+    return false;
+  Cell *row = back(c.y);
+  // Overwriting half of a wide rune leaves the other half blank.
+  if (row[c.x].width == 0)
+    row[c.x - 1] = Cell();
+  const int last = c.x + width - 1;
+  if (row[last].width == 2 && last + 1 < width_)
+    row[last + 1] = Cell();
+  row[c.x] = {rune, uint8_t(width)};
+  if (width == 2)
+    row[c.x + 1] = {0, 0};
+  return true;
+}
+
+uint64_t Screen::HashRow(const Cell *row) const {
+  // FNV-1a.
+  uint64_t h = 14695981039346656037UL;
+  for (int x = 0; x < width_; ++x) {
+    h = (h ^ row[x].rune) * 1099511628211UL;
+    h = (h ^ row[x].width) * 1099511628211UL;
+  }
+  return h;
+}
+
+void Screen::ScrollIfShifted(ANSITerminal &vt) {
+  if (height_ < 3)
+    return;
+  std::vector<uint64_t> &hf = front_hashes_, &hb = back_hashes_;
+  int same = 0;
+  for (int y = 0; y < height_; ++y) {
+    hf[y] = HashRow(front(y));
+    hb[y] = HashRow(back(y));
+    same += hf[y] == hb[y];
+  }
+  // Positive shift scrolls up.
+  int best = same, shift = 0;
+  for (int k = 1; k < height_; ++k) {
+    if (hb[0] == hf[k]) {
+      int matched = 0;
+      for (int y = 0; y + k < height_; ++y)
+        matched += hb[y] == hf[y + k];
+      if (matched > best) {
+        best = matched;
+        shift = k;
+      }
+    }
+    if (hb[k] == hf[0]) {
+      int matched = 0;
+      for (int y = 0; y + k < height_; ++y)
+        matched += hb[y + k] == hf[y];
+      if (matched > best) {
+        best = matched;
+        shift = -k;
+      }
+    }
+  }
+  // Scrolling costs about as much as repainting a short row.
+  if (best - same < 2)
+    return;
+  const int k = std::abs(shift);
+  vt.SetScrollRegion(0, height_ - 1);
+  if (shift > 0)
+    vt.ScrollUp(k);
+  else
+    vt.ScrollDown(k);
+  vt.ResetScrollRegion();
+  cursor_ = {-1, 0};
+  const size_t n = size_t(k) * width_;
+  if (shift > 0) {
+    std::copy(front_.begin() + n, front_.end(), front_.begin());
+    std::fill(front_.end() - n, front_.end(), Cell());
+  } else {
+    std::copy_backward(front_.begin(), front_.end() - n, front_.end());
+    std::fill(front_.begin(), front_.begin() + n, Cell());
+  }
+}
+
+void Screen::MoveTo(ANSITerminal &vt, Cursor c) {
+  if (cursor_ == c)
+    return;
+  if (cursor_.y >= 0 && c.y == cursor_.y + 1 && c.x == 0)
+    vt.Put("\r\n");
+  else
+    vt.MoveCursor(c);
+  cursor_ = c;
+}
+
+void Screen::RefreshRow(ANSITerminal &vt, int y) {
+  const Cell *f = front(y), *b = back(y);
+  int x = 0;
+  while (x < width_) {
+    if (f[x] == b[x]) {
+      ++x;
+      continue;
+    }
+    // A wide rune is sent as a whole.
+    const int begin = b[x].width == 0 ? x - 1 : x;
+    int end = x + 1;
+    for (int i = end, gap = 0; i < width_ && gap <= kMaxGap; ++i) {
+      if (f[i] != b[i]) {
+        end = i + 1;
+        gap = 0;
+      } else {
+        ++gap;
+      }
+    }
+    MoveTo(vt, {y, begin});
+    int next = begin;
+    for (int i = begin; i < end; ++i) {
+      if (b[i].width == 0)
+        continue;
+      vt.PutRune(b[i].rune);
+      next = i + b[i].width;
+    }
+    // The cursor waits to wrap at the last column, where it's unknown.
+    cursor_ = next < width_ ? Cursor(y, next) : Cursor(-1, 0);
+    x = std::max(end, next);
+  }
+}
+
+void Screen::Refresh(ANSITerminal &vt) {
+  if (invalid_) {
+    vt.Clear();
+    std::fill(front_.begin(), front_.end(), Cell());
+    cursor_ = {-1, 0};
+    invalid_ = false;
+  } else {
+    ScrollIfShifted(vt);
+  }
+  for (int y = 0; y < height_; ++y)
+    RefreshRow(vt, y);
+  front_ = back_;
+  if (target_.y >= 0)
+    MoveTo(vt, target_);
+  vt.Refresh();
+}
+
+} // namespace emcc::tui
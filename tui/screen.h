@@ -0,0 +1,70 @@
+#pragma once
+
+#include "tui/cursor.h"
+#include "tui/terminal.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace emcc::tui {
+
+// Double buffered screen. Frames are drawn into the back buffer, Refresh
+// compares it with the front buffer, which is what the terminal shows, and
+// only sends runs of changed cells. Shifted content is scrolled by the
+// terminal rather than repainted.
+class Screen {
+public:
+  Screen(int height, int width);
+
+  int height() const { return height_; }
+  int width() const { return width_; }
+  // Contents are lost, the next Refresh repaints everything.
+  void Resize(int height, int width);
+  // The terminal was changed by someone else, repaint everything on the
+  // next Refresh.
+  void Invalidate() { invalid_ = true; }
+
+  // Fill the back buffer with blanks.
+  void Clear();
+  // A rune of width 2 also covers the cell to its right. Returns false if c
+  // is out of the screen.
+  bool Put(Cursor c, uint32_t rune, int width);
+
+  // Where the cursor is left by Refresh, nowhere in particular if y is
+  // negative.
+  void set_cursor(Cursor c) { target_ = c; }
+
+  void Refresh(ANSITerminal &vt);
+
+private:
+  struct Cell {
+    uint32_t rune = ' ';
+    // 0 for cells covered by a wide rune on their left.
+    uint8_t width = 1;
+
+    bool operator==(const Cell &other) const {
+      return rune == other.rune && width == other.width;
+    }
+    bool operator!=(const Cell &other) const { return !(*this == other); }
+  };
+
+  Cell *front(int y) { return &front_[y * width_]; }
+  Cell *back(int y) { return &back_[y * width_]; }
+  uint64_t HashRow(const Cell *row) const;
+  // Scroll the terminal if most rows of the back buffer are rows of the
+  // front buffer shifted.
+  void ScrollIfShifted(ANSITerminal &vt);
+  void RefreshRow(ANSITerminal &vt, int y);
+  void MoveTo(ANSITerminal &vt, Cursor c);
+
+  int height_, width_;
+  std::vector<Cell> front_, back_;
+  // Hashes of rows, kept to not allocate on every frame.
+  std::vector<uint64_t> front_hashes_, back_hashes_;
+  bool invalid_;
+  // Where the terminal cursor is, y is -1 if unknown.
+  Cursor cursor_;
+  Cursor target_;
+};
+
+} // namespace emcc::tui
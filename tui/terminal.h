@@ -6,16 +6,20 @@
 
 #include "fmt/format.h"
 #include "support/misc.h"
+#include "support/utf8.h"
 #include "support/wcwidth.h"
 #include "tui/cursor.h"
 
 #include <functional>
+#include <iterator>
+#include <string_view>
 #include <vector>
 
 namespace emcc::tui {
 
-// FIXME: Need to investigate why is ncurses is much faster by comparing
-// benchmarks/page_benchmark2 and benchmarks/page_benchmark3.
+// Commands are buffered until Refresh. The buffer is reused across frames,
+// so no memory is allocated once it is large enough. Use Screen to send only
+// changes of frames.
 // See http://ascii-table.com/ansi-escape-sequences.php
 class ANSITerminal {
 public:
@@ -34,8 +38,35 @@ public:
     x = ws.ws_col;
   }
 
+  // c is 0-based, while the terminal counts from 1.
   ANSITerminal &MoveCursor(Cursor c) {
-    command_.append(fmt::format("\x1B[{};{}H", c.y, c.x));
+    fmt::format_to(std::back_inserter(command_), "\x1B[{};{}H", c.y + 1,
+                   c.x + 1);
+    return *this;
+  }
+
+  // Restrict scrolling to rows [top, bottom]. The cursor is moved home.
+  ANSITerminal &SetScrollRegion(int top, int bottom) {
+    fmt::format_to(std::back_inserter(command_), "\x1B[{};{}r", top + 1,
+                   bottom + 1);
+    return *this;
+  }
+
+  ANSITerminal &ResetScrollRegion() {
+    static const char cs[] = "\x1B[r";
+    command_.append(cs);
+    return *this;
+  }
+
+  // Move contents of the scroll region up by n rows, blank rows are shown
+  // at the bottom.
+  ANSITerminal &ScrollUp(int n) {
+    fmt::format_to(std::back_inserter(command_), "\x1B[{}S", n);
+    return *this;
+  }
+
+  ANSITerminal &ScrollDown(int n) {
+    fmt::format_to(std::back_inserter(command_), "\x1B[{}T", n);
     return *this;
   }
 
@@ -53,20 +84,31 @@ public:
 
   void Refresh() {
     ::write(out_, command_.data(), command_.length());
+    bytes_written_ += command_.length();
     command_.clear();
   }
 
-  ANSITerminal &Put(const std::string &cs) {
+  // Total size of commands sent by Refresh.
+  size_t bytes_written() const { return bytes_written_; }
+
+  ANSITerminal &Put(std::string_view cs) {
     command_.append(cs);
     return *this;
   }
 
+  ANSITerminal &PutRune(uint32_t rune) {
+    char buf[4];
+    command_.append(buf, EncodeUTF8(rune, buf));
+    return *this;
+  }
+
 private:
   static std::vector<std::function<void(void)>> atexit_functions;
   static void Clean();
 
   int in_, out_;
   std::string command_;
+  size_t bytes_written_ = 0;
 };
 
 } // namespace emcc::tui
@@ -0,0 +1,124 @@
+#include "support/btree_rope.h"
+#include "support/random.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <time.h>
+
+namespace {
+
+// Small nodes to get a deep tree from few chars.
+using Rope = emcc::BTreeRope<char, 16, 4>;
+
+std::string ReadAll(const Rope &rope) {
+  std::string s;
+  rope.Read(0, Rope::npos, s);
+  return s;
+}
+
+std::string RandomString(emcc::Random &rnd, size_t size) {
+  std::string s;
+  for (size_t i = 0; i < size; ++i)
+    s.push_back('a' + 26 * rnd.Next());
+  return s;
+}
+
+TEST(BTreeRopeTest, RandomEdit) {
+  emcc::Random rnd(std::time(nullptr));
+  Rope rope;
+  std::string expected;
+  for (int i = 0; i < (1 << 13); ++i) {
+    size_t index = rnd.Next() * (expected.size() + 1);
+    if (rnd.Next() < 0.6) {
+      std::string s = RandomString(rnd, rnd.Next() < 0.9 ? 1 : 100);
+      rope.Insert(index, s);
+      expected.insert(std::min(index, expected.size()), s);
+    } else {
+      size_t len = 64 * rnd.Next();
+      EXPECT_TRUE(rope.Erase(index, len) ==
+                  (index < expected.size()
+                       ? std::min(len, expected.size() - index)
+                       : 0));
+      if (index < expected.size())
+        expected.erase(index, len);
+    }
+    ASSERT_TRUE(rope.size() == expected.size());
+  }
+  EXPECT_TRUE(ReadAll(rope) == expected);
+  for (size_t i = 0; i < expected.size(); ++i)
+    EXPECT_TRUE(rope.At(i) == expected[i]);
+  rope.Erase(0, Rope::npos);
+  EXPECT_TRUE(rope.empty() && rope.height() == 0);
+}
+
+TEST(BTreeRopeTest, Append) {
+  Rope rope;
+  std::string expected;
+  for (int i = 0; i < 10000; ++i) {
+    rope.Append('a' + i % 26);
+    expected.push_back('a' + i % 26);
+  }
+  EXPECT_TRUE(ReadAll(rope) == expected);
+  // Appending keeps leaves full.
+  EXPECT_TRUE(rope.height() <= std::log2(expected.size() / 16) + 2);
+  std::string read(100, 0);
+  EXPECT_TRUE(rope.Read(5000, 100, read.data()) == 100);
+  EXPECT_TRUE(read == expected.substr(5000, 100));
+}
+
+TEST(BTreeRopeTest, Concat) {
+  emcc::Random rnd(std::time(nullptr));
+  for (size_t lhs_size : {0, 1, 10, 100, 10000}) {
+    for (size_t rhs_size : {0, 1, 10, 100, 10000}) {
+      std::string lhs = RandomString(rnd, lhs_size);
+      std::string rhs = RandomString(rnd, rhs_size);
+      Rope rope(lhs), other(rhs);
+      rope.Concat(std::move(other));
+      EXPECT_TRUE(other.empty());
+      EXPECT_TRUE(ReadAll(rope) == lhs + rhs);
+      rope.Insert(lhs_size, 'x');
+      EXPECT_TRUE(ReadAll(rope) == lhs + "x" + rhs);
+    }
+  }
+}
+
+TEST(BTreeRopeTest, SplitAndCopy) {
+  std::string s(1000, 0);
+  for (size_t i = 0; i < s.size(); ++i)
+    s[i] = 'a' + i % 26;
+  Rope rope(s);
+  EXPECT_TRUE(ReadAll(rope.Copy(100, 300)) == s.substr(100, 300));
+  Rope tail = rope.Split(400);
+  EXPECT_TRUE(ReadAll(rope) == s.substr(0, 400));
+  EXPECT_TRUE(ReadAll(tail) == s.substr(400));
+  Rope erased;
+  tail.Erase(10, 20, &erased);
+  EXPECT_TRUE(ReadAll(erased) == s.substr(410, 20));
+}
+
+TEST(BTreeRopeTest, RandomSplit) {
+  emcc::Random rnd(std::time(nullptr));
+  const std::string s = RandomString(rnd, 2000);
+  for (int i = 0; i < 200; ++i) {
+    Rope rope;
+    // Appends and inserts in the middle give nodes of uneven sizes.
+    for (size_t j = 0; j < s.size(); j += 100)
+      rope.Insert(rope.size() / 2, s.substr(j, 100));
+    const std::string expected = ReadAll(rope);
+    const size_t index = rnd.Next() * (expected.size() + 1);
+    Rope tail = rope.Split(index);
+    EXPECT_TRUE(ReadAll(rope) == expected.substr(0, index));
+    EXPECT_TRUE(ReadAll(tail) == expected.substr(index));
+    EXPECT_EQ(rope.size() + tail.size(), expected.size());
+    rope.Insert(rope.size() / 2, "x");
+    tail.Erase(0, 1);
+    rope.Concat(std::move(tail));
+    std::string edited = expected;
+    edited.insert(index / 2, "x");
+    if (index < edited.size() - 1)
+      edited.erase(index + 1, 1);
+    EXPECT_TRUE(ReadAll(rope) == edited);
+  }
+}
+
+} // namespace
@@ -1,7 +1,10 @@
 #include "editor/buffer_view.h"
+#include "support/random.h"
+#include "support/utf8_scan.h"
 
 #include <gtest/gtest.h>
 #include <iostream>
+#include <time.h>
 
 namespace {
 
@@ -40,4 +43,280 @@ TEST(BufferViewTest, Basic2) {
   EXPECT_TRUE(view.NumLines() == 1);
 }
 
+TEST(BufferViewTest, GetRow) {
+  std::string msg;
+  for (int i = 0; i < 1000; ++i)
+    msg += std::string(i % 37, 'a' + i % 26) + "\n";
+  MonoBuffer buffer;
+  buffer.Append(msg.data(), msg.length());
+  BufferView view(&buffer, 1UL << 20, 8);
+  EXPECT_TRUE(view.NumLines() == 1000);
+  // Compare with walking the rows one by one.
+  size_t row = 0;
+  for (auto it = view.row_begin(); it != view.row_end(); ++it, ++row) {
+    auto seg = view.GetRow(row);
+    ASSERT_TRUE(seg.has_value());
+    EXPECT_TRUE(seg->begin() == (*it).begin() && seg->end() == (*it).end());
+  }
+  EXPECT_TRUE(row == view.NumRows());
+  EXPECT_FALSE(view.GetRow(row).has_value());
+  size_t n = 0;
+  for (auto seg : view.row_range(100, 200)) {
+    EXPECT_TRUE(seg.begin() == view.GetRow(100 + n)->begin());
+    ++n;
+  }
+  EXPECT_TRUE(n == 100);
+  view.Resize(1UL << 20, 16);
+  EXPECT_TRUE(view.NumRows() < row);
+  EXPECT_TRUE(view.GetRow(view.NumRows() - 1).has_value());
+  EXPECT_FALSE(view.GetRow(view.NumRows()).has_value());
+}
+
+// Leading n segments of lhs and rhs are the same.
+bool SameSegments(LineView &lhs, LineView &rhs, size_t n) {
+  for (size_t seg = 0; seg < n; ++seg) {
+    auto l = lhs.GetSegment(seg), r = rhs.GetSegment(seg);
+    auto it = r.begin();
+    for (auto &cv : l) {
+      if (it == r.end() || cv.point != (*it).point || cv.rune != (*it).rune)
+        return false;
+      ++it;
+    }
+    if (it != r.end())
+      return false;
+  }
+  return true;
+}
+
+bool SameLayout(LineView &lhs, LineView &rhs) {
+  return lhs.height() == rhs.height() && SameSegments(lhs, rhs, lhs.height());
+}
+
+TEST(LineViewTest, Edit) {
+  emcc::Random rnd(std::time(nullptr));
+  const std::string runes[] = {"a", "bc", "世", "界", "😀", " "};
+  // Edits are aligned to runes, which are mirrored here.
+  std::vector<std::string> line;
+  for (int i = 0; i < 2000; ++i) {
+    line.push_back(runes[size_t(rnd.Next() * 6)]);
+    // Long ASCII runs are stored compactly.
+    if (rnd.Next() < 0.01)
+      line.insert(line.end(), 300, "a");
+  }
+  std::string s = "head\n";
+  for (auto &rune : line)
+    s += rune;
+  s += "\ntail\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  BufferView view(&buffer, 1UL << 20, 13);
+  LineView lv(&buffer, 1, 13);
+  for (int i = 0; i < 500; ++i) {
+    size_t index = rnd.Next() * (line.size() + 1), offset = 0, start;
+    for (size_t j = 0; j < index; ++j)
+      offset += line[j].size();
+    buffer.ComputeOffset(1, 0, start);
+    size_t removed = 0, inserted = 0;
+    if (rnd.Next() < 0.5) {
+      std::string text;
+      for (int n = rnd.Next() * 8; n > 0; --n) {
+        line.insert(line.begin() + index++, runes[size_t(rnd.Next() * 6)]);
+        text += line[index - 1];
+      }
+      buffer.Insert(start + offset, text);
+      inserted = text.size();
+    } else {
+      for (int n = rnd.Next() * 8; n > 0 && index < line.size(); --n) {
+        removed += line[index].size();
+        line.erase(line.begin() + index);
+      }
+      buffer.Erase(start + offset, removed);
+    }
+    lv.Edit(offset, removed, inserted);
+    view.EditLine(1, offset, removed, inserted);
+    LineView expected(&buffer, 1, 13);
+    ASSERT_TRUE(SameLayout(lv, expected));
+  }
+  LineView tail(&buffer, 2, 13);
+  EXPECT_TRUE((*view.GetRow(view.NumRows() - 1)->begin()).point ==
+              (*tail.GetSegment(0).begin()).point);
+}
+
+TEST(LineViewTest, Compact) {
+  emcc::Random rnd(std::time(nullptr));
+  const std::string runes[] = {"a", "b", "，", "世", "é", "😀", "\u0301"};
+  std::string s;
+  for (int i = 0; i < 100000; ++i) {
+    s += rnd.Next() < 0.5 ? runes[size_t(rnd.Next() * 7)] : "x";
+    if (rnd.Next() < 0.001)
+      s += std::string(rnd.Next() * 1000, 'y');
+  }
+  s += "\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  LineView lv(&buffer, 0, 80);
+  // Compare with decoding every char.
+  std::vector<CharView> expected;
+  emcc::DecodeUTF8(s.data(), s.size(), [&](size_t point, uint32_t rune) {
+    CharView cv;
+    cv.point = point;
+    cv.rune = rune;
+    cv.width = rune == '\n' ? 1 : emcc::wchar_width(rune);
+    expected.push_back(cv);
+  });
+  // Same rule as LineView, minimize the gap at the end of a segment.
+  std::vector<size_t> breaks;
+  size_t offset = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    size_t width = expected[i].length(), s = offset + width;
+    size_t gap = s > 80 ? ~0UL : 80 - s, next_gap = emcc::abs_diff(width, 80UL);
+    if (gap <= next_gap) {
+      offset = s;
+    } else {
+      breaks.push_back(i);
+      offset = width;
+    }
+  }
+  ASSERT_TRUE(lv.height() == breaks.size() + 1);
+  size_t i = 0;
+  for (size_t seg = 0; seg < lv.height(); ++seg) {
+    if (seg > 0) {
+      EXPECT_TRUE(i == breaks[seg - 1]);
+    }
+    for (auto &cv : lv.GetSegment(seg)) {
+      ASSERT_TRUE(i < expected.size());
+      EXPECT_TRUE(cv.point == expected[i].point &&
+                  cv.rune == expected[i].rune &&
+                  cv.width == expected[i].width);
+      ++i;
+    }
+  }
+  EXPECT_TRUE(i == expected.size());
+  EXPECT_TRUE(lv.MemoryUsage() * 5 <= expected.size() * sizeof(CharView));
+}
+
+TEST(BufferViewTest, RePosition) {
+  emcc::Random rnd(std::time(nullptr));
+  std::string s;
+  for (int i = 0; i < 500; ++i) {
+    size_t len = rnd.Next() < 0.02 ? 20000 : rnd.Next() * 100;
+    for (size_t j = 0; j < len; ++j)
+      s += j % 5 ? "a" : "世";
+    s += "\n";
+  }
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  BufferView view(&buffer, 40, 30);
+  size_t baseline = 0;
+  for (int i = 0; i < 2000; ++i) {
+    // Mostly scroll by a few lines, in both directions.
+    if (rnd.Next() < 0.1)
+      baseline = rnd.Next() * buffer.NumLines();
+    else if (rnd.Next() < 0.5)
+      baseline = std::min(buffer.NumLines() - 1,
+                          baseline + size_t(rnd.Next() * 5));
+    else
+      baseline -= std::min(baseline, size_t(rnd.Next() * 5));
+    view.RePosition(baseline);
+    BufferView expected(&buffer, 40, 30);
+    expected.RePosition(baseline);
+    ASSERT_TRUE(view.NumLines() == expected.NumLines());
+    const size_t rows = std::min(view.NumRows(), expected.NumRows());
+    ASSERT_TRUE(rows >= std::min<size_t>(40, expected.NumRows()));
+    for (size_t row = 0; row < rows; ++row) {
+      auto l = *view.GetRow(row), r = *expected.GetRow(row);
+      ASSERT_TRUE((*l.begin()).point == (*r.begin()).point);
+    }
+  }
+}
+
+TEST(BufferViewTest, ParallelResize) {
+  std::string s;
+  for (int i = 0; i < 20; ++i)
+    s += std::string(100000 + i, 'a') + "世界\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  emcc::ThreadPool pool(4);
+  BufferView view(&buffer, 1UL << 20, 80, nullptr, &pool);
+  for (size_t width : {7, 80, 13}) {
+    view.Resize(1UL << 20, width);
+    BufferView expected(&buffer, 1UL << 20, width);
+    ASSERT_TRUE(view.NumRows() == expected.NumRows());
+    for (size_t row = 0; row < view.NumRows(); row += 97) {
+      ASSERT_TRUE((*view.GetRow(row)->begin()).point ==
+                  (*expected.GetRow(row)->begin()).point);
+    }
+  }
+}
+
+TEST(LineViewTest, Window) {
+  emcc::Random rnd(std::time(nullptr));
+  const std::string runes[] = {"a", "bc", "世", "😀", "\u0301", " "};
+  std::vector<std::string> line;
+  for (int i = 0; i < 100000; ++i)
+    line.push_back(runes[size_t(rnd.Next() * 6)]);
+  std::string s;
+  for (auto &rune : line)
+    s += rune;
+  s += "\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  LineView lv(&buffer, 0, 13, 50);
+  EXPECT_FALSE(lv.IsFullyLaidOut());
+  EXPECT_TRUE(lv.height() >= 50);
+  EXPECT_TRUE(lv.MemoryUsage() < s.size() / 4);
+  for (int i = 0; i < 200; ++i) {
+    if (rnd.Next() < 0.5) {
+      lv.Extend(lv.height() + rnd.Next() * 100);
+    } else {
+      // Edits inside and past the laid out prefix.
+      size_t index = rnd.Next() * line.size(), offset = 0;
+      for (size_t j = 0; j < index; ++j)
+        offset += line[j].size();
+      size_t removed = 0;
+      for (int n = rnd.Next() * 4; n > 0 && index < line.size(); --n) {
+        removed += line[index].size();
+        line.erase(line.begin() + index);
+      }
+      const std::string &rune = runes[size_t(rnd.Next() * 6)];
+      line.insert(line.begin() + index, rune);
+      buffer.Erase(offset, removed);
+      buffer.Insert(offset, rune);
+      lv.Edit(offset, removed, rune.size());
+    }
+    LineView expected(&buffer, 0, 13);
+    ASSERT_TRUE(lv.height() <= expected.height());
+    ASSERT_TRUE(SameSegments(lv, expected, lv.height()));
+  }
+  lv.Extend(LineView::npos);
+  EXPECT_TRUE(lv.IsFullyLaidOut());
+  LineView expected(&buffer, 0, 13);
+  EXPECT_TRUE(SameLayout(lv, expected));
+}
+
+TEST(BufferViewTest, LongLine) {
+  std::string s = "head\n";
+  for (int i = 0; i < 1000000; ++i)
+    s += i % 7 ? "a" : "世";
+  s += "\ntail\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  BufferView view(&buffer, 50, 80);
+  EXPECT_TRUE(view.NumRows() >= 50);
+  EXPECT_TRUE(view.NumLines() == 2);
+  LineView expected(&buffer, 1, 80);
+  // Rows are laid out as they are scrolled to.
+  for (size_t h = 100; h < expected.height() + 100; h += 1000) {
+    view.Extend(h);
+    ASSERT_TRUE(view.NumRows() >= std::min(h, expected.height() + 2));
+    // Row 0 is the head line.
+    size_t seg = std::min(h, expected.height()) - 1;
+    EXPECT_TRUE((*view.GetRow(seg + 1)->begin()).point ==
+                (*expected.GetSegment(seg).begin()).point);
+  }
+  view.Extend(expected.height() + 100);
+  EXPECT_TRUE(view.NumLines() == 3);
+  EXPECT_TRUE(view.NumRows() == expected.height() + 2);
+}
+
 } // namespace
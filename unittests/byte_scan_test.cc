@@ -0,0 +1,37 @@
+#include "support/byte_scan.h"
+#include "support/random.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+using namespace emcc;
+
+TEST(ByteScanTest, Basic) {
+  std::string s("a\nbc\n\nd");
+  std::vector<size_t> found;
+  ForEachByte(s.data(), s.size(), '\n', [&](size_t i) { found.push_back(i); });
+  EXPECT_TRUE((found == std::vector<size_t>{1, 4, 5}));
+  EXPECT_TRUE(CountByte(s.data(), s.size(), 'x') == 0);
+}
+
+TEST(ByteScanTest, CompareScalar) {
+  Random rnd(std::time(nullptr));
+  for (size_t len = 0; len < 300; ++len) {
+    std::string s;
+    for (size_t i = 0; i < len; ++i)
+      s.push_back(rnd.Next() < 0.2 ? '\n' : 'a');
+    std::vector<size_t> expected, found;
+    for (size_t i = 0; i < s.size(); ++i)
+      if (s[i] == '\n')
+        expected.push_back(i);
+    ForEachByte(s.data(), s.size(), '\n',
+                [&](size_t i) { found.push_back(i); });
+    EXPECT_TRUE(found == expected);
+  }
+}
+
+} // namespace
@@ -0,0 +1,159 @@
+#include "support/chan.h"
+#include "support/epoll.h"
+#include "support/histogram.h"
+
+#include <chrono>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace emcc;
+using Clock = std::chrono::steady_clock;
+
+// Items put by each producer.
+const int Num = 1 << 18;
+const size_t Cap = 1 << 8;
+
+template <typename Chan>
+void ResetReceiveChan(Chan &c) {
+  c.reset_receive_chan();
+}
+
+// GoChan counts items in its eventfd, get reads it.
+template <typename T>
+void ResetReceiveChan(GoChan<T> &) {}
+
+void Report(const std::string &name, int num_items, double seconds,
+            const Histogram *latency) {
+  std::cout << name << ": " << num_items / seconds / 1e6 << "M items/s";
+  if (latency) {
+    std::cout << ", latency p50 " << latency->Percentile(0.5) << "ns p99 "
+              << latency->Percentile(0.99) << "ns";
+  }
+  std::cout << std::endl;
+}
+
+// Producers put timestamps as fast as they can, consumers spin on get.
+template <typename Chan>
+void BenchSpin(const std::string &name, Chan &c, int num_items,
+               int num_producers, int num_consumers) {
+  const auto start = Clock::now();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_producers; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < num_items; ++i) {
+        while (!c.put(i))
+          std::this_thread::yield();
+      }
+    });
+  }
+  const int total = num_items * num_producers;
+  std::atomic<int> received(0);
+  for (int t = 0; t < num_consumers; ++t) {
+    threads.emplace_back([&] {
+      int res;
+      while (received < total) {
+        if (c.get(res))
+          ++received;
+        else
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  const std::chrono::duration<double> seconds = Clock::now() - start;
+  Report(name, total, seconds.count(), nullptr);
+  EXPECT_TRUE(c.empty());
+}
+
+// A single consumer sleeps on receive_chan by EPoll, latency is from put to
+// get.
+template <typename Chan>
+void BenchEPoll(const std::string &name, Chan &c, int num_items,
+                int num_producers) {
+  const auto start = Clock::now();
+  std::vector<std::thread> producers;
+  for (int t = 0; t < num_producers; ++t) {
+    producers.emplace_back([&] {
+      for (int i = 0; i < num_items; ++i) {
+        while (!c.put(Clock::now().time_since_epoch().count()))
+          std::this_thread::yield();
+      }
+    });
+  }
+  const int total = num_items * num_producers;
+  Histogram latency;
+  EPoll ep;
+  ep.MonitorReadEvent(c.receive_chan());
+  std::vector<epoll_event> events(1);
+  for (int received = 0; received < total;) {
+    int num_events;
+    ASSERT_TRUE(ep.Wait(-1, &events, &num_events));
+    ResetReceiveChan(c);
+    Clock::rep sent;
+    while (c.get(sent)) {
+      latency.Add(Clock::now().time_since_epoch().count() - sent);
+      ++received;
+    }
+  }
+  for (auto &t : producers)
+    t.join();
+  const std::chrono::duration<double> seconds = Clock::now() - start;
+  Report(name, total, seconds.count(), &latency);
+}
+
+TEST(ChanBenchmark, SingleProducerSpin) {
+  {
+    GoChan<int> c(Cap, false);
+    BenchSpin("GoChan", c, Num, 1, 1);
+  }
+  {
+    SPSCChan<int> c(Cap);
+    BenchSpin("SPSCChan", c, Num, 1, 1);
+  }
+  {
+    MPMCChan<int> c(Cap);
+    BenchSpin("MPMCChan", c, Num, 1, 1);
+  }
+}
+
+TEST(ChanBenchmark, ContendedSpin) {
+  {
+    GoChan<int> c(Cap, false);
+    BenchSpin("GoChan 4x4", c, Num, 4, 4);
+  }
+  {
+    MPMCChan<int> c(Cap);
+    BenchSpin("MPMCChan 4x4", c, Num, 4, 4);
+  }
+}
+
+TEST(ChanBenchmark, EPoll) {
+  {
+    GoChan<Clock::rep> c(Cap, false);
+    BenchEPoll("GoChan", c, Num, 1);
+  }
+  {
+    SPSCChan<Clock::rep> c(Cap, true);
+    BenchEPoll("SPSCChan", c, Num, 1);
+  }
+  {
+    MPMCChan<Clock::rep> c(Cap, true);
+    BenchEPoll("MPMCChan", c, Num, 1);
+  }
+  {
+    GoChan<Clock::rep> c(Cap, false);
+    BenchEPoll("GoChan 4 producers", c, Num, 4);
+  }
+  {
+    MPMCChan<Clock::rep> c(Cap, true);
+    BenchEPoll("MPMCChan 4 producers", c, Num, 4);
+  }
+}
+
+} // namespace
@@ -1,8 +1,11 @@
 #include "support/chan.h"
 #include "support/epoll.h"
 
+#include <atomic>
 #include <gtest/gtest.h>
+#include <string>
 #include <thread>
+#include <vector>
 
 namespace {
 
@@ -153,4 +156,130 @@ TEST(GoChanBenchmark, ReadWrite) {
   EXPECT_TRUE(c.empty());
 }
 
+TEST(SPSCChanTest, Basic) {
+  SPSCChan<int> c(3);
+  EXPECT_TRUE(c.capacity() == 4);
+  EXPECT_TRUE(c.receive_chan() < 0);
+  int res;
+  EXPECT_TRUE(!c.get(res));
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i)
+      EXPECT_TRUE(c.put(round * 4 + i));
+    EXPECT_TRUE(!c.put(-1));
+    EXPECT_TRUE(c.size() == 4);
+    for (int i = 0; i < 4; ++i)
+      EXPECT_TRUE(c.get(res) && res == round * 4 + i);
+    EXPECT_TRUE(!c.get(res));
+    EXPECT_TRUE(c.empty());
+  }
+}
+
+TEST(SPSCChanTest, Threads) {
+  const int Num = 1 << 20;
+  SPSCChan<int> c(1 << 6);
+  auto t = std::thread([&] {
+    for (int i = 0; i < Num; ++i) {
+      while (!c.put(i))
+        std::this_thread::yield();
+    }
+  });
+  for (int i = 0; i < Num; ++i) {
+    int res;
+    while (!c.get(res))
+      std::this_thread::yield();
+    ASSERT_TRUE(res == i);
+  }
+  t.join();
+  EXPECT_TRUE(c.empty());
+}
+
+TEST(MPMCChanTest, Basic) {
+  MPMCChan<std::string> c(4);
+  EXPECT_TRUE(c.capacity() == 4);
+  std::string res;
+  EXPECT_TRUE(!c.get(res));
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i)
+      EXPECT_TRUE(c.put(std::to_string(i)));
+    EXPECT_TRUE(!c.put("full"));
+    EXPECT_TRUE(c.size() == 4);
+    for (int i = 0; i < 4; ++i)
+      EXPECT_TRUE(c.get(res) && res == std::to_string(i));
+    EXPECT_TRUE(!c.get(res));
+  }
+}
+
+TEST(MPMCChanTest, Threads) {
+  const int Num = 1 << 18, NumThreads = 4;
+  MPMCChan<int> c(1 << 6);
+  std::vector<std::atomic<int>> received(Num * NumThreads);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < NumThreads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < Num; ++i) {
+        while (!c.put(t * Num + i))
+          std::this_thread::yield();
+      }
+    });
+    threads.emplace_back([&] {
+      for (int i = 0; i < Num; ++i) {
+        int res;
+        while (!c.get(res))
+          std::this_thread::yield();
+        ++received[res];
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+  for (auto &count : received)
+    ASSERT_TRUE(count == 1);
+  EXPECT_TRUE(c.empty());
+}
+
+// The consumer sleeps on the eventfd, which is written only when the ring
+// turns non-empty, no wakeup may be lost.
+template <typename Chan>
+void TestEPollWakeup(Chan &c, int num_producers) {
+  const int Num = 1 << 16;
+  std::vector<std::thread> producers;
+  for (int t = 0; t < num_producers; ++t) {
+    producers.emplace_back([&] {
+      for (int i = 0; i < Num; ++i) {
+        while (!c.put(i))
+          std::this_thread::yield();
+      }
+    });
+  }
+  EPoll ep;
+  ep.MonitorReadEvent(c.receive_chan());
+  std::vector<epoll_event> events(1);
+  long received = 0, wakeups = 0;
+  while (received < long(Num) * num_producers) {
+    int num_events;
+    ASSERT_TRUE(ep.Wait(1000, &events, &num_events));
+    ASSERT_TRUE(num_events == 1);
+    ++wakeups;
+    c.reset_receive_chan();
+    int res;
+    while (c.get(res))
+      ++received;
+  }
+  for (auto &t : producers)
+    t.join();
+  EXPECT_TRUE(c.empty());
+  EXPECT_TRUE(wakeups <= received);
+}
+
+TEST(SPSCChanTest, EPoll) {
+  SPSCChan<int> c(1 << 4, true);
+  EXPECT_TRUE(c.receive_chan() >= 0);
+  TestEPollWakeup(c, 1);
+}
+
+TEST(MPMCChanTest, EPoll) {
+  MPMCChan<int> c(1 << 4, true);
+  TestEPollWakeup(c, 3);
+}
+
 } // namespace
@@ -0,0 +1,76 @@
+#include "support/file_writer.h"
+#include "support/sys.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+using namespace emcc;
+
+std::string ReadFile(const std::string &filename) {
+  auto membuf = MemoryBuffer::OpenIfExists(filename);
+  if (!membuf)
+    return "";
+  return std::string(membuf->buffer(), membuf->length());
+}
+
+TEST(FileWriterTest, ManySpans) {
+  char filename[] = "/tmp/file_writer_test.XXXXXX";
+  ::close(::mkstemp(filename));
+  ::chmod(filename, 0640);
+  // More spans than a single writev accepts.
+  std::vector<std::string> spans;
+  std::string expected;
+  for (size_t i = 0; i < 3 * IOV_MAX; ++i) {
+    spans.emplace_back(i % 17 + 1, 'a' + i % 26);
+    expected.append(spans.back());
+  }
+  for (auto policy :
+       {SyncPolicy::kNone, SyncPolicy::kData, SyncPolicy::kFull}) {
+    AtomicFileWriter writer(filename, policy);
+    EXPECT_TRUE(writer.is_open());
+    for (auto &span : spans)
+      EXPECT_TRUE(writer.Write(span.data(), span.size()));
+    EXPECT_TRUE(writer.Commit());
+    EXPECT_TRUE(ReadFile(filename) == expected);
+    struct stat statbuf;
+    EXPECT_TRUE(::stat(filename, &statbuf) == 0);
+    EXPECT_TRUE((statbuf.st_mode & 07777) == 0640);
+  }
+  ::unlink(filename);
+}
+
+TEST(FileWriterTest, NewFileUmask) {
+  char dirname[] = "/tmp/file_writer_test.XXXXXX";
+  ASSERT_TRUE(::mkdtemp(dirname));
+  const std::string filename = std::string(dirname) + "/new";
+  const mode_t old_mask = ::umask(0);
+  for (mode_t mask : {0022, 0077, 0002}) {
+    ::umask(mask);
+    AtomicFileWriter writer(filename);
+    EXPECT_TRUE(writer.Write("new", 3));
+    EXPECT_TRUE(writer.Commit());
+    struct stat statbuf;
+    EXPECT_TRUE(::stat(filename.c_str(), &statbuf) == 0);
+    EXPECT_TRUE((statbuf.st_mode & 07777) == (0666 & ~mask));
+    ::unlink(filename.c_str());
+  }
+  ::umask(old_mask);
+  ::rmdir(dirname);
+}
+
+TEST(FileWriterTest, NotCommitted) {
+  char filename[] = "/tmp/file_writer_test.XXXXXX";
+  int fd = ::mkstemp(filename);
+  EXPECT_TRUE(::write(fd, "old", 3) == 3);
+  ::close(fd);
+  {
+    AtomicFileWriter writer(filename);
+    EXPECT_TRUE(writer.Write("new", 3));
+    EXPECT_TRUE(writer.Flush());
+  }
+  EXPECT_TRUE(ReadFile(filename) == "old");
+  ::unlink(filename);
+}
+
+} // namespace
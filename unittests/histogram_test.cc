@@ -0,0 +1,50 @@
+#include "support/histogram.h"
+#include "support/random.h"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+using namespace emcc;
+
+TEST(HistogramTest, Small) {
+  Histogram h;
+  EXPECT_TRUE(h.Percentile(0.99) == 0);
+  for (uint64_t i = 1; i <= 10; ++i)
+    h.Add(i);
+  EXPECT_TRUE(h.count() == 10);
+  EXPECT_TRUE(h.max() == 10);
+  // Small values are counted exactly.
+  EXPECT_TRUE(h.Percentile(0.5) == 5);
+  EXPECT_TRUE(h.Percentile(0.99) == 10);
+  EXPECT_TRUE(h.Percentile(0) == 1);
+  h.clear();
+  EXPECT_TRUE(h.count() == 0 && h.max() == 0);
+}
+
+TEST(HistogramTest, Percentile) {
+  Random rnd(std::time(nullptr));
+  Histogram h;
+  std::vector<uint64_t> values;
+  for (int i = 0; i < 100000; ++i) {
+    // Spread over several orders of magnitude.
+    const uint64_t value = std::exp(rnd.Next() * 30);
+    h.Add(value);
+    values.push_back(value);
+  }
+  h.Add(~0ULL);
+  values.push_back(~0ULL);
+  std::sort(values.begin(), values.end());
+  for (double p : {0.01, 0.5, 0.9, 0.99, 0.999}) {
+    const uint64_t expected = values[std::ceil(p * values.size()) - 1];
+    const uint64_t actual = h.Percentile(p);
+    EXPECT_TRUE(actual >= expected);
+    EXPECT_TRUE(actual - expected <= expected / Histogram::kSubBuckets);
+  }
+  EXPECT_TRUE(h.Percentile(1) == ~0ULL);
+}
+
+} // namespace
@@ -0,0 +1,128 @@
+#include "editor/buffer_view.h"
+#include "editor/layout_cache.h"
+#include "support/random.h"
+
+#include <gtest/gtest.h>
+#include <time.h>
+
+namespace {
+
+using namespace emcc::editor;
+
+bool SameLayout(LineView &lhs, LineView &rhs) {
+  if (lhs.height() != rhs.height())
+    return false;
+  for (size_t seg = 0; seg < lhs.height(); ++seg) {
+    auto l = lhs.GetSegment(seg), r = rhs.GetSegment(seg);
+    auto it = r.begin();
+    for (auto &cv : l) {
+      if (it == r.end() || cv.point != (*it).point || cv.rune != (*it).rune)
+        return false;
+      ++it;
+    }
+    if (it != r.end())
+      return false;
+  }
+  return true;
+}
+
+std::string MakeText(size_t num_lines) {
+  std::string s;
+  for (size_t i = 0; i < num_lines; ++i)
+    s += std::string(i % 37, 'a' + i % 26) + "世界\n";
+  return s;
+}
+
+TEST(LayoutCacheTest, Basic) {
+  std::string s = MakeText(100);
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  LayoutCache cache(&buffer, 1UL << 20);
+  LineView lv = cache.Get(30, 8);
+  EXPECT_TRUE(cache.misses() == 1 && cache.hits() == 0);
+  cache.Put(30, std::move(lv));
+  EXPECT_TRUE(cache.size() == 1);
+  EXPECT_TRUE(cache.MemoryUsage() > 0);
+  lv = cache.Get(30, 8);
+  EXPECT_TRUE(cache.hits() == 1);
+  EXPECT_TRUE(cache.size() == 0);
+  LineView expected(&buffer, 30, 8);
+  EXPECT_TRUE(SameLayout(lv, expected));
+  // Keyed by width too.
+  cache.Put(30, std::move(lv));
+  lv = cache.Get(30, 9);
+  EXPECT_TRUE(cache.misses() == 2);
+  EXPECT_TRUE(cache.size() == 1);
+  cache.clear();
+  EXPECT_TRUE(cache.size() == 0 && cache.MemoryUsage() == 0);
+}
+
+TEST(LayoutCacheTest, Evict) {
+  std::string s = MakeText(100);
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  LayoutCache cache(&buffer, 1UL << 20);
+  for (size_t line = 0; line < 100; ++line)
+    cache.Put(line, LineView(&buffer, line, 8));
+  EXPECT_TRUE(cache.size() == 100);
+  const size_t per_line = cache.MemoryUsage() / 100;
+  cache.set_budget(per_line * 20);
+  EXPECT_TRUE(cache.MemoryUsage() <= cache.budget());
+  // Least recently put lines are gone.
+  cache.Get(0, 8);
+  EXPECT_TRUE(cache.misses() == 1);
+  cache.Get(99, 8);
+  EXPECT_TRUE(cache.hits() == 1);
+  cache.set_budget(0);
+  EXPECT_TRUE(cache.size() == 0);
+}
+
+TEST(LayoutCacheTest, Edit) {
+  std::string s = MakeText(100);
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  LayoutCache cache(&buffer, 1UL << 20);
+  for (size_t line = 0; line < 100; ++line)
+    cache.Put(line, LineView(&buffer, line, 8));
+  // Line 10 is split, lines after it are moved down.
+  size_t offset;
+  buffer.ComputeOffset(10, 3, offset);
+  buffer.Insert(offset, "b\nc");
+  EXPECT_TRUE(cache.size() == 99);
+  buffer.ComputeOffset(50, 1, offset);
+  buffer.Erase(offset, 2);
+  EXPECT_TRUE(cache.size() == 98);
+  for (size_t line = 0; line < buffer.NumLines(); ++line) {
+    const size_t hits = cache.hits();
+    LineView lv = cache.Get(line, 8);
+    EXPECT_TRUE((cache.hits() == hits) ==
+                (line == 10 || line == 11 || line == 50));
+    LineView expected(&buffer, line, 8);
+    ASSERT_TRUE(SameLayout(lv, expected));
+  }
+}
+
+TEST(LayoutCacheTest, BufferView) {
+  emcc::Random rnd(std::time(nullptr));
+  std::string s = MakeText(5000);
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  LayoutCache cache(&buffer, 1UL << 20);
+  BufferView view(&buffer, 40, 13, &cache);
+  // Jump between a few regions.
+  const size_t regions[] = {0, 1000, 2500, 4900};
+  for (int i = 0; i < 100; ++i) {
+    const size_t baseline = regions[i % 4] + rnd.Next() * 10;
+    view.RePosition(baseline);
+    BufferView expected(&buffer, 40, 13);
+    expected.RePosition(baseline);
+    ASSERT_TRUE(view.NumRows() == expected.NumRows());
+    for (size_t row = 0; row < view.NumRows(); ++row) {
+      ASSERT_TRUE((*view.GetRow(row)->begin()).point ==
+                  (*expected.GetRow(row)->begin()).point);
+    }
+  }
+  EXPECT_TRUE(cache.hits() > cache.misses());
+}
+
+} // namespace
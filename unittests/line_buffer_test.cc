@@ -1,6 +1,8 @@
 #include "core/line_buffer.h"
 
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 namespace {
 using namespace emcc;
@@ -127,4 +129,23 @@ TEST(LineBufferTest, Size) {
   EXPECT_TRUE(lb.CountChars() == 8000);
 }
 
+TEST(LineBufferTest, SaveFile) {
+  LineBuffer lb;
+  std::string expected;
+  for (size_t i = 0; i < (1 << 12); ++i) {
+    char c = i % 31 ? 'a' : '\n';
+    lb.Append(c);
+    expected.push_back(c);
+  }
+  char filename[] = "/tmp/line_buffer_test.XXXXXX";
+  ::close(::mkstemp(filename));
+  EXPECT_TRUE(lb.SaveFile(filename, SyncPolicy::kNone));
+  auto saved = LineBuffer::CreateFromFile(filename);
+  ::unlink(filename);
+  std::string content;
+  for (size_t i = 0; i < saved->CountLines(); ++i)
+    saved->GetLine(i, ~0U, content);
+  EXPECT_TRUE(content == expected);
+}
+
 } // namespace
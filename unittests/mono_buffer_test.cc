@@ -1,6 +1,10 @@
 #include "core/mono_buffer.h"
+#include "support/random.h"
 
 #include <gtest/gtest.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
 
 namespace {
 using namespace emcc;
@@ -69,4 +73,254 @@ TEST(MonoBufferTest, EraseTest2) {
   EXPECT_TRUE(s == "bc");
 }
 
+TEST(MonoBufferTest, BulkAppend) {
+  std::string s;
+  for (size_t i = 0; i < (1 << 12); ++i) {
+    s.append(i % 97, 'a');
+    s.push_back('\n');
+  }
+  s.append("tail");
+  MonoBuffer mb;
+  mb.Append(s.data(), s.size() / 3);
+  mb.Append(s.data() + s.size() / 3, s.size() - s.size() / 3);
+  EXPECT_TRUE(mb.size() == s.size());
+  EXPECT_TRUE(mb.NumLines() == (1 << 12) + 1);
+  EXPECT_TRUE(mb.Verify());
+  std::string line;
+  mb.GetLine(mb.NumLines() - 1, 80, line);
+  EXPECT_TRUE(line == "tail");
+}
+
+TEST(MonoBufferTest, InsertString) {
+  MonoBuffer mb;
+  mb.Insert(0, std::string_view("ab"));
+  EXPECT_TRUE(mb.NumLines() == 1);
+  mb.Insert(1, std::string_view("\nc\nd"));
+  EXPECT_TRUE(mb.NumLines() == 3);
+  EXPECT_TRUE(mb.GetLineSize(0) == 2);
+  EXPECT_TRUE(mb.GetLineSize(1) == 2);
+  EXPECT_TRUE(mb.GetLineSize(2) == 2);
+  mb.Insert(mb.size(), std::string_view("\n"));
+  mb.Insert(mb.size(), std::string_view("e"));
+  EXPECT_TRUE(mb.NumLines() == 4);
+  EXPECT_TRUE(mb.Verify());
+}
+
+TEST(MonoBufferTest, RandomStringEdit) {
+  Random rnd(std::time(nullptr));
+  MonoBuffer mb;
+  std::string expected;
+  for (int i = 0; i < 2000; ++i) {
+    size_t offset = rnd.Next() * (expected.size() + 1);
+    if (rnd.Next() < 0.6) {
+      std::string text;
+      for (int j = rnd.Next() * 64; j > 0; --j)
+        text.push_back(rnd.Next() < 0.2 ? '\n' : 'a');
+      mb.Insert(offset, text);
+      expected.insert(std::min(offset, expected.size()), text);
+    } else {
+      size_t len = rnd.Next() * 64;
+      mb.Erase(offset, len);
+      if (offset < expected.size())
+        expected.erase(offset, len);
+    }
+    ASSERT_TRUE(mb.Verify());
+  }
+  std::string out;
+  mb.Read(0, mb.size(), out);
+  EXPECT_TRUE(out == expected);
+}
+
+TEST(MonoBufferTest, LargePaste) {
+  std::string text;
+  for (size_t i = 0; i < (1 << 14); ++i) {
+    text.append(i % 127, 'a');
+    text.push_back('\n');
+  }
+  MonoBuffer mb;
+  mb.Append("head\ntail", 9);
+  mb.Insert(5, text);
+  EXPECT_TRUE(mb.NumLines() == (1 << 14) + 2);
+  mb.Erase(5, text.size());
+  EXPECT_TRUE(mb.NumLines() == 2);
+  EXPECT_TRUE(mb.Verify());
+}
+
+std::string WriteTempFile(const std::string &content) {
+  char filename[] = "/tmp/mono_buffer_test.XXXXXX";
+  int fd = ::mkstemp(filename);
+  EXPECT_TRUE(fd >= 0);
+  EXPECT_TRUE(::write(fd, content.data(), content.size()) ==
+              (ssize_t)content.size());
+  ::close(fd);
+  return filename;
+}
+
+void LoadFileTest(const LoadOptions &options) {
+  std::string s;
+  for (size_t i = 0; i < (1 << 16); ++i) {
+    s.append(i % 251, 'a');
+    s.push_back('\n');
+  }
+  s.append("tail");
+  std::string filename = WriteTempFile(s);
+  auto mb = MonoBuffer::CreateFromFile(filename, options);
+  ::unlink(filename.c_str());
+  EXPECT_TRUE(mb->size() == s.size());
+  EXPECT_TRUE(mb->NumLines() == (1 << 16) + 1);
+  EXPECT_TRUE(mb->Verify());
+  std::string line;
+  mb->GetLine(mb->NumLines() - 1, 80, line);
+  EXPECT_TRUE(line == "tail");
+  mb->Insert(1, 0, 'b');
+  mb->Insert(1, 1, '\n');
+  mb->Erase(3, 0, 1);
+  EXPECT_TRUE(mb->Verify());
+  line.clear();
+  mb->GetLine(1, 80, line);
+  EXPECT_TRUE(line == "b\n");
+}
+
+TEST(MonoBufferTest, ParallelLoad) {
+  LoadOptions options;
+  options.num_threads = 4;
+  options.parallel_threshold = 0;
+  LoadFileTest(options);
+}
+
+TEST(MonoBufferTest, MMapLoad) {
+  LoadOptions options;
+  options.mmap = true;
+  LoadFileTest(options);
+  options.num_threads = 4;
+  options.parallel_threshold = 0;
+  LoadFileTest(options);
+}
+
+TEST(MonoBufferTest, SaveFile) {
+  std::string s;
+  for (size_t i = 0; i < (1 << 12); ++i) {
+    s.append(i % 97, 'a');
+    s.push_back('\n');
+  }
+  std::string filename = WriteTempFile(s);
+  LoadOptions options;
+  options.mmap = true;
+  auto mb = MonoBuffer::CreateFromFile(filename, options);
+  mb->Insert(0, 'b');
+  s.insert(0, 1, 'b');
+  std::string out;
+  EXPECT_TRUE(mb->Read(0, 3, out) == 3);
+  EXPECT_TRUE(out == "b\na");
+  // Overwrite the file mb refers to.
+  EXPECT_TRUE(mb->SaveFile(filename));
+  auto saved = MonoBuffer::CreateFromFile(filename);
+  ::unlink(filename.c_str());
+  out.clear();
+  EXPECT_TRUE(saved->Read(0, saved->size(), out) == s.size());
+  EXPECT_TRUE(out == s);
+  out.clear();
+  EXPECT_TRUE(mb->Read(0, mb->size(), out) == s.size());
+  EXPECT_TRUE(out == s);
+  EXPECT_TRUE(mb->IsUTF8Encoded());
+}
+
+TEST(MonoBufferTest, BackgroundIndex) {
+  std::string s;
+  for (size_t i = 0; i < (1 << 16); ++i) {
+    s.append(i % 251, 'a');
+    s.push_back('\n');
+  }
+  s.append("tail");
+  std::string filename = WriteTempFile(s);
+  LoadOptions options;
+  options.background_index = true;
+  for (bool mmap : {false, true}) {
+    options.mmap = mmap;
+    auto mb = MonoBuffer::CreateFromFile(filename, options);
+    EXPECT_TRUE(mb->size() == s.size());
+    // Edit leading lines before all lines are indexed.
+    mb->Insert(1, 0, 'b');
+    mb->Insert(1, 1, '\n');
+    mb->Erase(3, 0, 1);
+    std::string line;
+    mb->GetLine(1, 80, line);
+    EXPECT_TRUE(line == "b\n");
+    EXPECT_TRUE(mb->WaitForLine((1 << 16) + 1));
+    EXPECT_FALSE(mb->WaitForLine((1 << 16) + 2));
+    EXPECT_TRUE(mb->IsFullyIndexed());
+    EXPECT_TRUE(mb->IndexedSize() == mb->size());
+    EXPECT_TRUE(mb->Verify());
+    line.clear();
+    mb->GetLine(mb->NumLines() - 1, 80, line);
+    EXPECT_TRUE(line == "tail");
+  }
+  ::unlink(filename.c_str());
+}
+
+TEST(MonoBufferTest, LinesChangedCallback) {
+  emcc::Random rnd(std::time(nullptr));
+  MonoBuffer mb;
+  // Mirror line sizes by callbacks.
+  std::vector<long> line_size;
+  size_t id = mb.AddLinesChangedCallback(
+      [&](size_t line, size_t removed, size_t inserted) {
+        ASSERT_TRUE(line + removed <= line_size.size());
+        line_size.erase(line_size.begin() + line,
+                        line_size.begin() + line + removed);
+        for (size_t i = line; i < line + inserted; ++i)
+          line_size.insert(line_size.begin() + i, mb.GetLineSize(i));
+      });
+  mb.Append("ab\ncd", 5);
+  MonoBuffer other;
+  other.Append("ef\ngh\n", 6);
+  mb.Concat(std::move(other));
+  for (int i = 0; i < 1000; ++i) {
+    const size_t offset = rnd.Next() * (mb.size() + 1);
+    const double p = rnd.Next();
+    if (p < 0.4)
+      mb.Insert(offset, rnd.Next() < 0.3 ? '\n' : 'a');
+    else if (p < 0.6)
+      mb.Insert(offset, std::string_view("xy\nz\n\n", 6));
+    else if (p < 0.7)
+      mb.Append("tail\nmore", 9);
+    else
+      mb.Erase(offset, 16 * rnd.Next());
+    ASSERT_TRUE(line_size.size() == mb.NumLines());
+    for (size_t line = 0; line < line_size.size(); ++line)
+      ASSERT_TRUE(line_size[line] == long(mb.GetLineSize(line)));
+  }
+  mb.RemoveLinesChangedCallback(id);
+  const size_t num_lines = line_size.size();
+  mb.Insert(0, '\n');
+  EXPECT_TRUE(line_size.size() == num_lines);
+}
+
+TEST(LineIndexerTest, Chunks) {
+  std::string s;
+  for (size_t i = 0; i < 1000; ++i) {
+    s.append(i % 37, 'a');
+    s.push_back('\n');
+  }
+  s.append("tail");
+  std::vector<long> expected;
+  size_t start = 0;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\n') {
+      expected.push_back(i + 1 - start);
+      start = i + 1;
+    }
+  }
+  expected.push_back(s.size() - start);
+  for (size_t chunk_size : {1UL, 7UL, 64UL, 1UL << 20}) {
+    LineIndexer indexer(s.data(), s.size(), chunk_size);
+    std::vector<long> line_size;
+    while (indexer.Wait(line_size))
+      ;
+    EXPECT_TRUE(line_size == expected);
+    EXPECT_TRUE(indexer.indexed() == s.size());
+    EXPECT_FALSE(indexer.Poll(line_size));
+  }
+}
+
 } // namespace
@@ -0,0 +1,97 @@
+#include "support/node_allocator.h"
+#include "support/prefix_sum.h"
+#include "support/random.h"
+#include "support/rope.h"
+
+#include <gtest/gtest.h>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+using namespace emcc;
+
+struct Counted {
+  static int live;
+  int value;
+  Counted(int value) : value(value) { ++live; }
+  ~Counted() { --live; }
+};
+
+int Counted::live = 0;
+
+TEST(NodeAllocatorTest, Reuse) {
+  PoolAllocator<Counted> allocator;
+  std::vector<Counted *> objects;
+  for (int i = 0; i < 5000; ++i)
+    objects.push_back(allocator.New(i));
+  EXPECT_TRUE(Counted::live == 5000);
+  Counted *freed = objects[42];
+  allocator.Delete(freed);
+  EXPECT_TRUE(Counted::live == 4999);
+  // The freed slot is reused first.
+  EXPECT_TRUE(allocator.New(-1) == freed);
+  for (int i = 0; i < 5000; ++i)
+    EXPECT_TRUE(objects[i]->value == (i == 42 ? -1 : i));
+  for (auto object : objects)
+    allocator.Delete(object);
+  EXPECT_TRUE(Counted::live == 0);
+}
+
+TEST(NodeAllocatorTest, SplitAndConcat) {
+  Random rnd(std::time(nullptr));
+  using Sum = PrefixSum<int, PoolAllocator>;
+  std::vector<int> values(1000);
+  for (auto &value : values)
+    value = rnd.Next() * 100;
+  Sum s;
+  s.Append(values.begin(), values.end());
+  for (int i = 0; i < 100; ++i) {
+    const size_t index = rnd.Next() * s.size();
+    // The tail shares the pool of s, then s absorbs it back.
+    auto tail = s.Split(index);
+    Sum erased;
+    tail.Erase(0, 3, &erased);
+    erased.Insert(0, 1);
+    s.Concat(std::move(erased));
+    s.Concat(std::move(tail));
+    s.Remove(index);
+    EXPECT_TRUE(s.size() == values.size());
+  }
+  {
+    // A temporary tree with its own pool, to be stolen by s.
+    Sum other;
+    other.Append(values.begin(), values.end());
+    s.Concat(std::move(other));
+  }
+  EXPECT_TRUE(s.size() == 2 * values.size());
+  s.clear();
+  s.Append(values.begin(), values.end());
+  int sum = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    sum += values[i];
+    EXPECT_TRUE(s.GetPrefixSum(i) == sum);
+  }
+}
+
+TEST(NodeAllocatorTest, RopeEdit) {
+  Random rnd(std::time(nullptr));
+  Rope<char, 4, PoolAllocator> rope("0123456789");
+  std::string expected("0123456789");
+  for (int i = 0; i < 1000; ++i) {
+    const size_t index = rnd.Next() * rope.size();
+    if (rnd.Next() < 0.5) {
+      rope.Insert(index, std::string("abcdefg"));
+      expected.insert(index, "abcdefg");
+    } else {
+      Rope<char, 4, PoolAllocator> erased;
+      rope.Erase(index, 5, &erased);
+      expected.erase(index, 5);
+    }
+    Rope<char, 4, PoolAllocator> tail(rope.Split(rope.size() / 2));
+    rope.Concat(std::move(tail));
+  }
+  EXPECT_TRUE(rope == expected);
+}
+
+} // namespace
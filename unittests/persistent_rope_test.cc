@@ -0,0 +1,89 @@
+#include "support/persistent_rope.h"
+#include "support/random.h"
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+using Rope = emcc::PersistentRope<char, 16>;
+
+std::string ReadAll(const Rope &rope) {
+  std::string s;
+  rope.Read(0, Rope::npos, s);
+  return s;
+}
+
+std::string RandomString(emcc::Random &rnd, size_t size) {
+  std::string s;
+  for (size_t i = 0; i < size; ++i)
+    s.push_back('a' + 26 * rnd.Next());
+  return s;
+}
+
+TEST(PersistentRopeTest, RandomEdit) {
+  emcc::Random rnd(std::time(nullptr));
+  Rope rope;
+  std::string expected;
+  for (int i = 0; i < (1 << 12); ++i) {
+    size_t index = rnd.Next() * (expected.size() + 1);
+    if (rnd.Next() < 0.6) {
+      std::string s = RandomString(rnd, rnd.Next() < 0.9 ? 1 : 100);
+      rope.Insert(index, s);
+      expected.insert(std::min(index, expected.size()), s);
+    } else {
+      size_t len = 32 * rnd.Next();
+      EXPECT_TRUE(rope.Erase(index, len) ==
+                  (index < expected.size()
+                       ? std::min(len, expected.size() - index)
+                       : 0));
+      if (index < expected.size())
+        expected.erase(index, len);
+    }
+    ASSERT_TRUE(rope.size() == expected.size());
+  }
+  EXPECT_TRUE(ReadAll(rope) == expected);
+  for (size_t i = 0; i < expected.size(); i += 7)
+    EXPECT_TRUE(rope.At(i) == expected[i]);
+  // AVL trees are at most 1.44 log2(n) high.
+  EXPECT_TRUE(rope.height() <= 1.45 * std::log2(expected.size()) + 2);
+}
+
+TEST(PersistentRopeTest, Snapshot) {
+  emcc::Random rnd(std::time(nullptr));
+  Rope rope(std::string(1 << 12, 'a'));
+  std::vector<std::pair<Rope, std::string>> snapshots;
+  std::string expected(1 << 12, 'a');
+  for (int i = 0; i < 256; ++i) {
+    snapshots.emplace_back(rope.Snapshot(), expected);
+    size_t index = rnd.Next() * expected.size();
+    rope.Insert(index, 'b');
+    expected.insert(index, 1, 'b');
+    rope.Erase(index / 2, 3);
+    expected.erase(index / 2, 3);
+  }
+  for (auto &[snapshot, s] : snapshots)
+    EXPECT_TRUE(ReadAll(snapshot) == s);
+  EXPECT_TRUE(ReadAll(rope) == expected);
+}
+
+TEST(PersistentRopeTest, ConcurrentRead) {
+  const std::string s(1 << 16, 'a');
+  Rope rope(s);
+  Rope snapshot = rope.Snapshot();
+  std::thread reader([&snapshot, &s] {
+    for (int i = 0; i < 64; ++i)
+      EXPECT_TRUE(ReadAll(snapshot) == s);
+  });
+  for (int i = 0; i < (1 << 12); ++i) {
+    rope.Insert(i * 13 % rope.size(), 'b');
+    rope.Erase(i * 7 % rope.size(), 1);
+  }
+  reader.join();
+  EXPECT_TRUE(rope.size() == s.size());
+}
+
+} // namespace
@@ -2,6 +2,7 @@
 #include "support/random.h"
 
 #include <gtest/gtest.h>
+#include <numeric>
 
 namespace {
 
@@ -94,6 +95,79 @@ TEST(PrefixSumTest, SearchTest1) {
   EXPECT_TRUE(s.UpperBound(7) == 4);
 }
 
+TEST(PrefixSumTest, AppendRange) {
+  PrefixSum<int> s;
+  std::vector<int> values;
+  for (int i = 0; i <= 100; ++i)
+    values.push_back(i);
+  s.Insert(0, 0);
+  s.Append(values.begin() + 1, values.end());
+  EXPECT_TRUE(s.size() == 101);
+  EXPECT_TRUE(s.height() <= 8);
+  for (int i = 0; i <= 100; ++i)
+    EXPECT_TRUE(s.GetPrefixSum(i) == i * (i + 1) / 2);
+}
+
+TEST(PrefixSumTest, RangeEdit) {
+  PrefixSum<int> s;
+  std::vector<int> expected, values;
+  Random rnd(std::time(nullptr));
+  for (int i = 0; i < 1000; ++i) {
+    size_t index = rnd.Next() * (expected.size() + 1);
+    if (rnd.Next() < 0.6) {
+      values.clear();
+      for (int j = rnd.Next() * 16; j > 0; --j)
+        values.push_back(rnd.Next() * 100);
+      s.Insert(index, values.begin(), values.end());
+      expected.insert(expected.begin() + index, values.begin(), values.end());
+    } else {
+      size_t len = std::min<size_t>(rnd.Next() * 16, expected.size() - index);
+      EXPECT_TRUE(s.Erase(index, len) == (len != 0));
+      expected.erase(expected.begin() + index,
+                     expected.begin() + index + len);
+    }
+    ASSERT_TRUE(s.size() == expected.size());
+  }
+  int sum = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    sum += expected[i];
+    EXPECT_TRUE(s.GetPrefixSum(i) == sum);
+  }
+  const size_t half = expected.size() / 2;
+  auto tail = s.Split(half);
+  EXPECT_TRUE(s.size() == half);
+  EXPECT_TRUE(tail.size() == expected.size() - half);
+  for (size_t i = 0; i < tail.size(); ++i)
+    EXPECT_TRUE(tail.At(i).value == expected[half + i]);
+}
+
+TEST(PrefixSumTest, Peek) {
+  PrefixSum<int> s;
+  std::vector<int> expected;
+  Random rnd(std::time(nullptr));
+  for (int i = 0; i < 1000; ++i) {
+    size_t index = rnd.Next() * (expected.size() + 1);
+    int value = 1 + rnd.Next() * 100;
+    s.Insert(index, value);
+    expected.insert(expected.begin() + index, value);
+    index = rnd.Next() * expected.size();
+    s.Add(index, 1);
+    ++expected[index];
+  }
+  s.set_splay_on_read(false);
+  int sum = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    sum += expected[i];
+    EXPECT_TRUE(s.Peek(i) == expected[i]);
+    EXPECT_TRUE(s.At(i) == expected[i]);
+    EXPECT_TRUE(s.PeekPrefixSum(i) == sum);
+    EXPECT_TRUE(s.GetPrefixSum(i) == sum);
+    EXPECT_TRUE(s.LowerBound(sum) == i);
+    EXPECT_TRUE(s.UpperBound(sum - 1) == i);
+  }
+  EXPECT_TRUE(s.LowerBound(sum + 1) == s.size());
+}
+
 TEST(PrefixSumTest, Benchmark) {
   PrefixSum<int> s;
   Random rnd(std::time(nullptr));
@@ -120,4 +194,65 @@ TEST(PrefixSumTest, Benchmark1) {
   // std::cout << s.height() << std::endl;
 }
 
+TEST(PrefixSumTest, PeekRange) {
+  PrefixSum<int> s;
+  std::vector<int> expected;
+  Random rnd(std::time(nullptr));
+  // Shaped by inserts and splays rather than built balanced.
+  for (int i = 0; i < 1000; ++i) {
+    size_t index = rnd.Next() * (expected.size() + 1);
+    s.Insert(index, i);
+    expected.insert(expected.begin() + index, i);
+    s.At(rnd.Next() * expected.size());
+  }
+  for (int i = 0; i < 100; ++i) {
+    size_t begin = rnd.Next() * expected.size();
+    size_t end = begin + rnd.Next() * 300;
+    std::vector<int> values;
+    s.PeekRange(begin, end, std::back_inserter(values));
+    end = std::min(end, expected.size());
+    ASSERT_TRUE(values == std::vector<int>(expected.begin() + begin,
+                                           expected.begin() + end));
+  }
+}
+
+TEST(PrefixSumTest, Assign) {
+  PrefixSum<int> s;
+  std::vector<int> values;
+  Random rnd(std::time(nullptr));
+  for (int i = 0; i < 1000; ++i) {
+    s.Insert(rnd.Next() * (i + 1), i);
+    s.At(rnd.Next() * (i + 1));
+    values.push_back(rnd.Next() * 100);
+  }
+  s.Assign(values.begin(), values.end());
+  int sum = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    sum += values[i];
+    ASSERT_TRUE(s.At(i) == values[i]);
+    ASSERT_TRUE(s.GetPrefixSum(i) == sum);
+  }
+  // Ranges of a tree shaped by splays.
+  for (int i = 0; i < 100; ++i) {
+    const size_t begin = rnd.Next() * values.size();
+    const size_t end = begin + rnd.Next() * (values.size() - begin);
+    for (size_t j = begin; j < end; ++j)
+      values[j] = rnd.Next() * 100;
+    s.Replace(begin, values.begin() + begin, values.begin() + end);
+    s.At(rnd.Next() * values.size());
+  }
+  sum = 0;
+  for (size_t i = 0; i < values.size(); ++i) {
+    sum += values[i];
+    ASSERT_TRUE(s.Peek(i) == values[i]);
+    ASSERT_TRUE(s.PeekPrefixSum(i) == sum);
+  }
+  // A different size is built anew.
+  values.resize(10);
+  s.Assign(values.begin(), values.end());
+  EXPECT_TRUE(s.size() == 10);
+  EXPECT_TRUE(s.GetPrefixSum(9) ==
+              std::accumulate(values.begin(), values.end(), 0));
+}
+
 } // namespace
@@ -1,12 +1,16 @@
 // Copyright (c) 2020 Kai Luo <gluokai@gmail.com>. All rights reserved.
 
+#include "support/btree_rope.h"
+#include "support/prefix_sum.h"
 #include "support/random.h"
 #include "support/rope.h"
 
+#include <chrono>
 #include <ext/rope>
 #include <gtest/gtest.h>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <time.h>
 
 namespace {
@@ -31,6 +35,15 @@ TEST(RopeBenchmark, RopeRandomInsert) {
   std::cout << "Rope nodes: " << rope.nodes() << std::endl;
 }
 
+TEST(RopeBenchmark, BTreeRopeRandomInsert) {
+  emcc::Random rnd(std::time(nullptr));
+  emcc::BTreeRope<char> rope;
+  for (size_t i = 0; i < (1 << 20); ++i) {
+    rope.Insert(rnd.NextInt() % (rope.size() + 1), '0');
+  }
+  std::cout << "BTreeRope height: " << rope.height() << std::endl;
+}
+
 TEST(RopeBenchmark, StringRandomInsert) {
   emcc::Random rnd(std::time(nullptr));
   std::string s;
@@ -51,6 +64,12 @@ TEST(RopeBenchmark, RopeAppend) {
     rope.Append('0');
 }
 
+TEST(RopeBenchmark, BTreeRopeAppend) {
+  emcc::BTreeRope<char> rope;
+  for (size_t i = 0; i < (1 << 25); ++i)
+    rope.Append('0');
+}
+
 TEST(RopeBenchmark, StringAppend) {
   std::string s;
   for (size_t i = 0; i < (1 << 25); ++i)
@@ -89,4 +108,239 @@ TEST(RopeBenchmark, CountNodes) {
   std::cout << "Rope meta size: " << rope.meta_size() << std::endl;
 }
 
+enum class AccessPattern {
+  kSequential,
+  kRandom,
+  // 90% accesses fall in 1% of the range.
+  kHotSpot,
+};
+
+std::vector<size_t> GenerateIndices(AccessPattern pattern, size_t size,
+                                    size_t count) {
+  emcc::Random rnd(std::time(nullptr));
+  std::vector<size_t> indices;
+  const size_t hot_size = std::max(size / 100, 1UL),
+               hot_start = rnd.Next() * (size - hot_size);
+  for (size_t i = 0; i < count; ++i) {
+    switch (pattern) {
+    case AccessPattern::kSequential:
+      indices.push_back(i % size);
+      break;
+    case AccessPattern::kRandom:
+      indices.push_back(rnd.Next() * size);
+      break;
+    case AccessPattern::kHotSpot:
+      indices.push_back(rnd.Next() < 0.9 ? hot_start + rnd.Next() * hot_size
+                                         : rnd.Next() * size);
+      break;
+    }
+  }
+  return indices;
+}
+
+const char *ToString(AccessPattern pattern) {
+  switch (pattern) {
+  case AccessPattern::kSequential:
+    return "sequential";
+  case AccessPattern::kRandom:
+    return "random";
+  case AccessPattern::kHotSpot:
+    return "hot spot";
+  }
+  return "";
+}
+
+template <typename F>
+double MeasureSeconds(F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+// Trees are rebuilt for every run, since splaying of a previous run changes
+// the shape of the tree.
+template <typename Build, typename F>
+void BenchmarkAccessPatterns(const char *name, Build &&build, size_t count,
+                             F &&read) {
+  for (auto pattern : {AccessPattern::kSequential, AccessPattern::kRandom,
+                       AccessPattern::kHotSpot}) {
+    std::vector<size_t> indices;
+    for (bool splay : {true, false}) {
+      auto tree = build();
+      if (indices.empty())
+        indices = GenerateIndices(pattern, tree->size(), count);
+      tree->set_splay_on_read(splay);
+      size_t checksum = 0;
+      double secs = MeasureSeconds([&] {
+        for (size_t i : indices)
+          checksum += read(*tree, i);
+      });
+      std::cout << name << ", " << ToString(pattern)
+                << (splay ? ", splay: " : ", no splay: ") << secs << "s"
+                << " (checksum " << checksum << ")" << std::endl;
+    }
+  }
+}
+
+template <typename Tree>
+std::unique_ptr<Tree> BuildRope(size_t size) {
+  std::string s(size, '0');
+  auto rope = std::make_unique<Tree>();
+  rope->Append(s.data(), s.size());
+  return rope;
+}
+
+TEST(RopeBenchmark, AccessPatterns) {
+  auto at = [](auto &rope, size_t i) { return rope.At(i); };
+  BenchmarkAccessPatterns(
+      "Rope At", [] { return BuildRope<Rope>(64UL << 20); }, 1UL << 22, at);
+  // Small pieces, as left by editing.
+  BenchmarkAccessPatterns(
+      "Rope<char, 64> At",
+      [] { return BuildRope<emcc::Rope<char, 64>>(16UL << 20); }, 1UL << 22,
+      at);
+}
+
+// Trees grown by one insert at a time are chains, until reads splay them.
+TEST(RopeBenchmark, AppendedAccessPatterns) {
+  BenchmarkAccessPatterns(
+      "Appended Rope<char, 64> At",
+      [] {
+        auto rope = std::make_unique<emcc::Rope<char, 64>>();
+        for (size_t i = 0; i < (1UL << 18); ++i)
+          rope->Append('0');
+        return rope;
+      },
+      1UL << 14, [](auto &rope, size_t i) { return rope.At(i); });
+  BenchmarkAccessPatterns(
+      "Appended PrefixSum GetPrefixSum",
+      [] {
+        auto prefix_sum = std::make_unique<emcc::PrefixSum<long>>();
+        for (size_t i = 0; i < (1UL << 14); ++i)
+          prefix_sum->Insert(prefix_sum->size(), 80);
+        return prefix_sum;
+      },
+      1UL << 14,
+      [](auto &prefix_sum, size_t i) { return prefix_sum.GetPrefixSum(i); });
+}
+
+TEST(RopeBenchmark, PrefixSumAccessPatterns) {
+  // One value per line, like MonoBuffer.
+  auto build = [] {
+    std::vector<long> values(1UL << 21, 80);
+    auto prefix_sum = std::make_unique<emcc::PrefixSum<long>>();
+    prefix_sum->Append(values.begin(), values.end());
+    return prefix_sum;
+  };
+  BenchmarkAccessPatterns(
+      "PrefixSum GetPrefixSum", build, 1UL << 21,
+      [](auto &prefix_sum, size_t i) { return prefix_sum.GetPrefixSum(i); });
+}
+
+template <template <typename> class Allocator>
+void BenchmarkPrefixSumAllocator(const char *name) {
+  emcc::Random rnd(std::time(nullptr));
+  std::vector<long> values(1UL << 21, 80);
+  auto prefix_sum = std::make_unique<emcc::PrefixSum<long, Allocator>>();
+  double build = MeasureSeconds(
+      [&] { prefix_sum->Append(values.begin(), values.end()); });
+  double edit = MeasureSeconds([&] {
+    for (size_t i = 0; i < (1UL << 20); ++i) {
+      prefix_sum->Insert(rnd.Next() * prefix_sum->size(), 80);
+      prefix_sum->Remove(rnd.Next() * prefix_sum->size());
+    }
+  });
+  double clear = MeasureSeconds([&] { prefix_sum.reset(); });
+  double insert = MeasureSeconds([&] {
+    emcc::PrefixSum<long, Allocator> s;
+    for (size_t i = 0; i < (1UL << 21); ++i)
+      s.Insert(i, 80);
+  });
+  std::cout << name << ": build " << build << "s, edit " << edit
+            << "s, clear " << clear << "s, one by one insert and clear "
+            << insert << "s" << std::endl;
+}
+
+template <template <typename> class Allocator>
+void BenchmarkRopeAllocator(const char *name) {
+  emcc::Random rnd(std::time(nullptr));
+  std::string s(256UL << 20, '0');
+  auto rope = std::make_unique<emcc::Rope<char, 1UL << 12, Allocator>>();
+  double build = MeasureSeconds([&] { rope->Append(s.data(), s.size()); });
+  double edit = MeasureSeconds([&] {
+    for (size_t i = 0; i < (1UL << 20); ++i)
+      rope->Insert(rnd.Next() * rope->size(), '1');
+  });
+  double clear = MeasureSeconds([&] { rope.reset(); });
+  std::cout << name << ": build " << build << "s, edit " << edit
+            << "s, clear " << clear << "s" << std::endl;
+}
+
+TEST(RopeBenchmark, NodeAllocators) {
+  BenchmarkPrefixSumAllocator<emcc::NewAllocator>("PrefixSum, NewAllocator");
+  BenchmarkPrefixSumAllocator<emcc::PoolAllocator>("PrefixSum, PoolAllocator");
+  BenchmarkRopeAllocator<emcc::NewAllocator>("Rope, NewAllocator");
+  BenchmarkRopeAllocator<emcc::PoolAllocator>("Rope, PoolAllocator");
+}
+
+// Same workload on all rope backends.
+template <typename Build, typename Insert, typename At>
+void BenchmarkBackend(const char *name, Build &&build, Insert &&insert,
+                      At &&at) {
+  const size_t size = 64UL << 20, count = 1UL << 22;
+  std::string s(size, '0');
+  auto rope = build(s);
+  double total = 0;
+  for (auto pattern : {AccessPattern::kSequential, AccessPattern::kRandom}) {
+    std::vector<size_t> indices = GenerateIndices(pattern, size, count);
+    size_t checksum = 0;
+    double secs = MeasureSeconds([&] {
+      for (size_t i : indices)
+        checksum += at(*rope, i);
+    });
+    total += secs;
+    std::cout << name << ", " << ToString(pattern) << " At: " << secs << "s"
+              << " (checksum " << checksum << ")" << std::endl;
+  }
+  emcc::Random rnd(std::time(nullptr));
+  double secs = MeasureSeconds([&] {
+    for (size_t i = 0; i < (1UL << 20); ++i)
+      insert(*rope, rnd.Next() * size, '1');
+  });
+  std::cout << name << ", random Insert: " << secs << "s" << std::endl;
+}
+
+TEST(RopeBenchmark, Backends) {
+  BenchmarkBackend(
+      "Rope",
+      [](const std::string &s) {
+        auto rope = std::make_unique<Rope>();
+        rope->Append(s.data(), s.size());
+        return rope;
+      },
+      [](Rope &rope, size_t i, char c) { rope.Insert(i, c); },
+      [](Rope &rope, size_t i) { return rope.At(i); });
+  BenchmarkBackend(
+      "BTreeRope",
+      [](const std::string &s) {
+        auto rope = std::make_unique<emcc::BTreeRope<char>>();
+        rope->Append(s.data(), s.size());
+        return rope;
+      },
+      [](emcc::BTreeRope<char> &rope, size_t i, char c) { rope.Insert(i, c); },
+      [](emcc::BTreeRope<char> &rope, size_t i) { return rope.At(i); });
+  BenchmarkBackend(
+      "__gnu_cxx::rope",
+      [](const std::string &s) {
+        // Built from a single array, it would be one flat leaf.
+        auto rope = std::make_unique<__gnu_cxx::rope<char>>();
+        for (size_t i = 0; i < s.size(); i += 1UL << 12)
+          rope->append(s.data() + i, 1UL << 12);
+        return rope;
+      },
+      [](__gnu_cxx::rope<char> &rope, size_t i, char c) { rope.insert(i, c); },
+      [](__gnu_cxx::rope<char> &rope, size_t i) { return rope[i]; });
+}
+
 } // namespace
@@ -125,6 +125,23 @@ TEST(RopeTest, RealEdit) {
   EXPECT_TRUE(rope == "!lol!Hello,  world!!!");
 }
 
+TEST(RopeTest, SmallInsertion) {
+  emcc::Random rnd(std::time(nullptr));
+  emcc::Rope<char, 64> rope;
+  std::string expected;
+  for (int i = 0; i < (1 << 14); ++i) {
+    std::string buffer = GenerateRandomString(1 + 3 * rnd.Next());
+    size_t index = expected.size() * rnd.Next();
+    expected.insert(index, buffer);
+    rope.Insert(index, buffer);
+  }
+  ASSERT_TRUE(rope == expected);
+#ifdef EMCC_DEBUG
+  // Small strings go into existing pieces.
+  EXPECT_TRUE(rope.nodes() < expected.size() / 16);
+#endif
+}
+
 TEST(RopeTest, ConcatTest) {
   Rope lhs, rhs;
   lhs.Append("Hey, ");
@@ -142,6 +159,17 @@ TEST(RopeTest, SplitTest) {
   EXPECT_TRUE(rhs == "Jude!");
 }
 
+TEST(RopeTest, SplayOnReadKept) {
+  Rope lhs("Hey, Jude!");
+  lhs.set_splay_on_read(false);
+  Rope rhs(lhs.Split(5));
+  EXPECT_TRUE(!rhs.splay_on_read());
+  Rope other("Hey");
+  other.swap(std::move(lhs));
+  EXPECT_TRUE(!other.splay_on_read() && lhs.splay_on_read());
+  EXPECT_TRUE(other == "Hey, " && lhs == "Hey");
+}
+
 TEST(RopeTest, CopyTest) {
   Rope lhs;
   lhs.Append("Hey, Jude!");
@@ -149,4 +177,87 @@ TEST(RopeTest, CopyTest) {
   EXPECT_TRUE(rhs == "Jude!");
 }
 
+TEST(RopeTest, ViewTest) {
+  const std::string s("Hey, Jude! Don't make it bad.");
+  emcc::Rope<char, 4> rope;
+  rope.AppendView(s.data(), 10);
+  rope.AppendView(s.data() + 10, s.size() - 10);
+  EXPECT_TRUE(rope == s);
+  std::string expected(s);
+  rope.Insert(5, 'X');
+  expected.insert(5, 1, 'X');
+  rope.Insert(0, 'Y');
+  expected.insert(0, 1, 'Y');
+  rope.Insert(rope.size(), 'Z');
+  expected.push_back('Z');
+  EXPECT_TRUE(rope == expected);
+  EXPECT_TRUE(rope.Erase(8, 6) == 6);
+  expected.erase(8, 6);
+  EXPECT_TRUE(rope == expected);
+  emcc::Rope<char, 4> tail(rope.Split(12));
+  EXPECT_TRUE(rope == expected.substr(0, 12));
+  EXPECT_TRUE(tail == expected.substr(12));
+}
+
+TEST(RopeTest, RandomViewEdit) {
+  emcc::Random rnd(std::time(nullptr));
+  const std::string s(GenerateRandomString(1 << 16));
+  std::string expected(s);
+  emcc::Rope<char, 16> rope;
+  rope.AppendView(s.data(), s.size());
+  for (int i = 0; i < (1 << 10); ++i) {
+    size_t index = rope.size() * rnd.Next();
+    if (rnd.Next() < 0.5) {
+      rope.Insert(index, '!');
+      expected.insert(index, 1, '!');
+    } else {
+      size_t len = 64 * rnd.Next();
+      rope.Erase(index, len);
+      expected.erase(index, len);
+    }
+  }
+  ASSERT_TRUE(rope == expected);
+}
+
+TEST(RopeTest, Peek) {
+  emcc::Random rnd(std::time(nullptr));
+  const std::string s(GenerateRandomString(1 << 12));
+  Rope rope;
+  for (size_t i = 0; i < s.size(); ++i)
+    rope.Insert(i, s[i]);
+  rope.set_splay_on_read(false);
+  for (int i = 0; i < (1 << 12); ++i) {
+    size_t index = rnd.Next() * s.size();
+    EXPECT_TRUE(rope.Peek(index) == s[index]);
+    EXPECT_TRUE(rope.At(index) == s[index]);
+  }
+}
+
+TEST(RopeTest, RandomRead) {
+  emcc::Random rnd(std::time(nullptr));
+  const std::string s(GenerateRandomString(1 << 14));
+  emcc::Rope<char, 16> rope;
+  std::string expected;
+  for (int i = 0; i < (1 << 10); ++i) {
+    size_t index = rope.size() * rnd.Next();
+    size_t len = 64 * rnd.Next();
+    std::string t(s.substr(s.size() * rnd.Next(), len));
+    rope.Insert(index, t);
+    expected.insert(index, t);
+  }
+  for (int i = 0; i < (1 << 10); ++i) {
+    size_t offset = expected.size() * rnd.Next();
+    size_t len = 256 * rnd.Next();
+    std::string out;
+    EXPECT_TRUE(rope.Read(offset, len, out) == out.size());
+    EXPECT_TRUE(out == expected.substr(offset, len));
+  }
+  std::string out;
+  EXPECT_TRUE(rope.Read(expected.size(), 1, out) == 0);
+  std::vector<char> all(rope.size());
+  EXPECT_TRUE(rope.Read(0, emcc::Rope<char, 16>::npos, all.data()) ==
+              expected.size());
+  EXPECT_TRUE(std::string(all.begin(), all.end()) == expected);
+}
+
 } // namespace
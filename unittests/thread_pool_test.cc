@@ -0,0 +1,30 @@
+#include "support/thread_pool.h"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <vector>
+
+namespace {
+
+using namespace emcc;
+
+TEST(ThreadPoolTest, Submit) {
+  ThreadPool pool(4);
+  std::vector<std::future<int>> results;
+  for (int i = 0; i < 100; ++i)
+    results.emplace_back(pool.Submit([i] { return i * i; }));
+  for (int i = 0; i < 100; ++i)
+    EXPECT_TRUE(results[i].get() == i * i);
+}
+
+TEST(ThreadPoolTest, DrainOnDestruction) {
+  std::atomic<int> count(0);
+  {
+    ThreadPool pool(2);
+    for (int i = 0; i < 100; ++i)
+      pool.Submit([&count] { ++count; });
+  }
+  EXPECT_TRUE(count == 100);
+}
+
+} // namespace
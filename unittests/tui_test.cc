@@ -1,8 +1,15 @@
 #include "core/mono_buffer.h"
 #include "support/misc.h"
+#include "support/random.h"
+#include "support/utf8.h"
+#include "support/wcwidth.h"
 #include "tui/cursor.h"
+#include "tui/screen.h"
 
+#include <fcntl.h>
 #include <gtest/gtest.h>
+#include <time.h>
+#include <unistd.h>
 
 namespace {
 using namespace emcc::tui;
@@ -76,4 +83,189 @@ TEST(RegionTest, ContainTest1) {
   EXPECT_TRUE(!region.contains({16, 2}));
 }
 
+// Interprets escape sequences sent by Screen, and keeps runes on the
+// terminal.
+class Emulator {
+public:
+  Emulator(int height, int width)
+      : height_(height), width_(width),
+        cells_(height, std::vector<uint32_t>(width, ' ')) {}
+
+  const std::vector<std::vector<uint32_t>> &cells() const { return cells_; }
+
+  void Feed(const std::string &s) {
+    for (size_t i = 0; i < s.size(); ++i) {
+      if (s[i] == '\x1B') {
+        i = Escape(s, i + 2);
+      } else if (s[i] == '\r') {
+        x_ = 0;
+      } else if (s[i] == '\n') {
+        ++y_;
+      } else if (emcc::DecodeUTF8(&state_, &rune_, s[i])) {
+        const int w = emcc::wchar_width(rune_);
+        ASSERT_TRUE(y_ < height_ && x_ + w <= width_);
+        cells_[y_][x_] = rune_;
+        if (w == 2)
+          cells_[y_][x_ + 1] = 0;
+        x_ += w;
+      }
+    }
+  }
+
+private:
+  size_t Escape(const std::string &s, size_t i) {
+    std::vector<int> args{0};
+    for (; isdigit(s[i]) || s[i] == ';'; ++i) {
+      if (s[i] == ';')
+        args.push_back(0);
+      else
+        args.back() = args.back() * 10 + s[i] - '0';
+    }
+    switch (s[i]) {
+    case 'H':
+      y_ = args[0] - 1;
+      x_ = args[1] - 1;
+      break;
+    case 'J':
+      for (auto &row : cells_)
+        std::fill(row.begin(), row.end(), ' ');
+      break;
+    case 'r':
+      y_ = x_ = 0;
+      break;
+    case 'S':
+      cells_.erase(cells_.begin(), cells_.begin() + args[0]);
+      cells_.resize(height_, std::vector<uint32_t>(width_, ' '));
+      break;
+    case 'T':
+      cells_.resize(height_ - args[0]);
+      cells_.insert(cells_.begin(), args[0],
+                    std::vector<uint32_t>(width_, ' '));
+      break;
+    default:
+      ADD_FAILURE() << "Unknown sequence " << s[i];
+    }
+    return i;
+  }
+
+  const int height_, width_;
+  std::vector<std::vector<uint32_t>> cells_;
+  int y_ = 0, x_ = 0;
+  uint32_t state_ = emcc::UTF8_ACCEPT, rune_ = 0;
+};
+
+class ScreenTest : public ::testing::Test {
+protected:
+  static constexpr int kHeight = 24, kWidth = 40;
+
+  void SetUp() override {
+    ASSERT_TRUE(::pipe(fds_) == 0);
+    ::fcntl(fds_[0], F_SETFL, O_NONBLOCK);
+  }
+
+  void TearDown() override {
+    ::close(fds_[0]);
+    ::close(fds_[1]);
+  }
+
+  // Draw rows, refresh and return what is sent to the terminal.
+  std::string Show(const std::vector<std::u32string> &rows) {
+    screen_.Clear();
+    for (int y = 0; y < int(rows.size()); ++y) {
+      int x = 0;
+      for (char32_t rune : rows[y]) {
+        const int w = emcc::wchar_width(rune);
+        screen_.Put({y, x}, rune, w);
+        x += w;
+      }
+    }
+    ANSITerminal vt(-1, fds_[1]);
+    screen_.Refresh(vt);
+    std::string out;
+    char buf[4096];
+    ssize_t n;
+    while ((n = ::read(fds_[0], buf, sizeof(buf))) > 0)
+      out.append(buf, n);
+    emulator_.Feed(out);
+    // Check the terminal shows what is drawn.
+    for (int y = 0; y < kHeight; ++y) {
+      std::u32string row;
+      for (uint32_t rune : emulator_.cells()[y])
+        if (rune)
+          row.push_back(rune);
+      std::u32string expected = y < int(rows.size()) ? rows[y] : U"";
+      while (row.size() > expected.size() && row.back() == ' ')
+        row.pop_back();
+      EXPECT_TRUE(row == expected) << "row " << y;
+    }
+    return out;
+  }
+
+  int fds_[2];
+  Screen screen_{kHeight, kWidth};
+  Emulator emulator_{kHeight, kWidth};
+};
+
+std::u32string RandomRow(emcc::Random &rnd, int width) {
+  static const char32_t runes[] = U"abc 世界";
+  std::u32string row;
+  for (int x = 0; x < width;) {
+    char32_t rune = runes[size_t(rnd.Next() * 6)];
+    x += emcc::wchar_width(rune);
+    if (x <= width)
+      row.push_back(rune);
+  }
+  return row;
+}
+
+TEST_F(ScreenTest, Diff) {
+  emcc::Random rnd(std::time(nullptr));
+  std::vector<std::u32string> rows;
+  for (int y = 0; y < kHeight; ++y)
+    rows.push_back(RandomRow(rnd, kWidth * rnd.Next()));
+  const size_t full = Show(rows).size();
+  EXPECT_TRUE(Show(rows).empty());
+  for (int i = 0; i < 100; ++i) {
+    // Change a few cells.
+    for (int n = 0; n < 3; ++n) {
+      auto &row = rows[size_t(rnd.Next() * kHeight)];
+      if (!row.empty())
+        row[size_t(rnd.Next() * row.size())] = U'x';
+    }
+    EXPECT_TRUE(Show(rows).size() < full / 4);
+  }
+  screen_.Invalidate();
+  EXPECT_TRUE(Show(rows).size() > full / 2);
+}
+
+TEST_F(ScreenTest, Scroll) {
+  emcc::Random rnd(std::time(nullptr));
+  std::vector<std::u32string> rows;
+  for (int y = 0; y < kHeight; ++y)
+    rows.push_back(RandomRow(rnd, kWidth));
+  const size_t full = Show(rows).size();
+  rows.erase(rows.begin(), rows.begin() + 3);
+  for (int y = 0; y < 3; ++y)
+    rows.push_back(RandomRow(rnd, kWidth));
+  std::string out = Show(rows);
+  EXPECT_TRUE(out.find("\x1B[3S") != std::string::npos);
+  EXPECT_TRUE(out.size() < full / 4);
+  rows.insert(rows.begin(), RandomRow(rnd, kWidth));
+  rows.pop_back();
+  out = Show(rows);
+  EXPECT_TRUE(out.find("\x1B[1T") != std::string::npos);
+  EXPECT_TRUE(out.size() < full / 4);
+}
+
+TEST_F(ScreenTest, WideRune) {
+  std::vector<std::u32string> rows{U"世界世界", U"abcd"};
+  Show(rows);
+  // Overwrite halves of wide runes.
+  rows[0] = U"a界 b";
+  rows[1] = U"世cd";
+  Show(rows);
+  rows[0] = U"";
+  Show(rows);
+}
+
 } // namespace
@@ -0,0 +1,112 @@
+#include "support/random.h"
+#include "support/utf8_scan.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+using namespace emcc;
+
+bool IsValidScalar(const std::string &s) {
+  uint32_t state = UTF8_ACCEPT, cp;
+  for (char c : s)
+    DecodeUTF8(&state, &cp, c);
+  return state == UTF8_ACCEPT;
+}
+
+// Valid runes of all lengths, with random bytes mixed in.
+std::string RandomText(Random &rnd, size_t len, double noise) {
+  static const char *runes[] = {"a", "\n", "é", "世", "界", "😀", "�"};
+  std::string s;
+  while (s.size() < len) {
+    if (rnd.Next() < noise)
+      s.push_back(rnd.NextInt() & 0xFF);
+    else
+      s += runes[size_t(rnd.Next() * 7)];
+  }
+  return s;
+}
+
+TEST(UTF8ScanTest, Basic) {
+  EXPECT_TRUE(IsValidUTF8("", 0));
+  std::string s = "你好世界 Hello, world 😀";
+  EXPECT_TRUE(IsValidUTF8(s.data(), s.size()));
+  EXPECT_FALSE(IsValidUTF8(s.data(), s.size() - 1));
+  // Overlong, surrogate and too large.
+  for (std::string bad : {"\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80",
+                          "\xF4\x90\x80\x80", "\xBF", "\xF8"}) {
+    std::string padded = std::string(40, 'a') + bad + std::string(40, 'b');
+    EXPECT_FALSE(IsValidUTF8(padded.data(), padded.size()));
+  }
+}
+
+// Every sequence of up to 3 bytes from a set of boundary bytes, at every
+// offset of a block.
+TEST(UTF8ScanTest, Boundaries) {
+  const uint8_t bytes[] = {0x00, 0x7F, 0x80, 0x8F, 0x90, 0x9F, 0xA0,
+                           0xBF, 0xC0, 0xC2, 0xDF, 0xE0, 0xED, 0xEF,
+                           0xF0, 0xF4, 0xF5, 0xFF};
+  std::vector<std::string> seqs;
+  for (uint8_t a : bytes) {
+    for (uint8_t b : bytes) {
+      seqs.push_back({char(a), char(b)});
+      for (uint8_t c : bytes)
+        seqs.push_back({char(a), char(b), char(c), char(0x80)});
+    }
+  }
+  for (auto &seq : seqs) {
+    for (size_t offset : {0, 13, 29, 30, 31, 32, 61}) {
+      std::string s = std::string(offset, 'a') + seq + std::string(70, 'a');
+      bool expected = IsValidScalar(s);
+      ASSERT_TRUE(IsValidUTF8(s.data(), s.size()) == expected);
+#ifdef EMCC_X86_SIMD
+      size_t validated;
+      bool ok = detail::ValidateUTF8SSSE3(s.data(), s.size(), validated);
+      ASSERT_TRUE(!expected || ok);
+      if (ok) {
+        ASSERT_TRUE(IsValidScalar(s.substr(validated)) == expected);
+      }
+#endif
+    }
+  }
+}
+
+TEST(UTF8ScanTest, Pieces) {
+  Random rnd(std::time(nullptr));
+  for (int i = 0; i < 2000; ++i) {
+    std::string s = RandomText(rnd, rnd.Next() * 600, i % 2 ? 0.002 : 0);
+    UTF8Validator validator;
+    for (size_t pos = 0; pos < s.size();) {
+      size_t len = std::min<size_t>(rnd.Next() * 100, s.size() - pos);
+      validator.Feed(s.data() + pos, len);
+      pos += len;
+    }
+    ASSERT_TRUE(validator.ok() == IsValidScalar(s));
+  }
+}
+
+TEST(UTF8ScanTest, Decode) {
+  Random rnd(std::time(nullptr));
+  for (int i = 0; i < 1000; ++i) {
+    std::string s = RandomText(rnd, rnd.Next() * 300, i % 2 ? 0.005 : 0);
+    std::vector<std::pair<size_t, uint32_t>> expected, runes;
+    uint32_t state = UTF8_ACCEPT, cp;
+    size_t start = 0;
+    for (size_t j = 0; j < s.size(); ++j) {
+      if (state == UTF8_ACCEPT)
+        start = j;
+      if (DecodeUTF8(&state, &cp, s[j]))
+        expected.emplace_back(start, cp);
+    }
+    bool ok = DecodeUTF8(s.data(), s.size(), [&](size_t j, uint32_t cp) {
+      runes.emplace_back(j, cp);
+    });
+    ASSERT_TRUE(ok == (state == UTF8_ACCEPT));
+    ASSERT_TRUE(runes == expected);
+  }
+}
+
+} // namespace
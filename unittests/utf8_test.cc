@@ -46,4 +46,38 @@ TEST(UTF8Test, WCWIDTH) {
   EXPECT_TRUE(wchar_width(us[3]) == 2);
 }
 
+TEST(UTF8Test, WCWIDTHTable) {
+  for (wchar_t ucs = -2; ucs < 0x110002; ++ucs) {
+    ASSERT_TRUE(wchar_width(ucs) == wchar_width_bisearch(ucs));
+    ASSERT_TRUE(wchar_width_cjk(ucs) == wchar_width_cjk_bisearch(ucs));
+  }
+}
+
+constexpr char EncodedLead(uint32_t codepoint) {
+  char out[4] = {};
+  EncodeUTF8(codepoint, out);
+  return out[0];
+}
+
+static_assert(EncodedLead('a') == 'a');
+
+TEST(UTF8Test, Encode) {
+  for (uint32_t codepoint :
+       {0x0U, 0x7FU, 0x80U, 0x7FFU, 0x800U, 0x4F60U, 0xFFFFU, 0x10000U,
+        0x1F600U, 0x10FFFFU}) {
+    char out[4];
+    size_t len = EncodeUTF8(codepoint, out);
+    uint32_t state = UTF8_ACCEPT, decoded = 0;
+    for (size_t i = 0; i < len; ++i)
+      DecodeUTF8(&state, &decoded, uint8_t(out[i]));
+    EXPECT_TRUE(state == UTF8_ACCEPT);
+    EXPECT_TRUE(decoded == codepoint);
+  }
+  char out[4];
+  for (uint32_t codepoint : {0xD800U, 0xDFFFU, 0x110000U}) {
+    EXPECT_TRUE(EncodeUTF8(codepoint, out) == 3);
+    EXPECT_TRUE(std::string(out, 3) == "\xEF\xBF\xBD");
+  }
+}
+
 } // namespace
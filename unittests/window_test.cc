@@ -0,0 +1,74 @@
+#include "em/em.h"
+
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using namespace emcc;
+using namespace std::chrono_literals;
+
+class WindowTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_TRUE(::pipe(fds_) == 0);
+    out_ = ::open("/dev/null", O_WRONLY);
+    ASSERT_TRUE(out_ >= 0);
+    std::string s;
+    for (int i = 0; i < 100; ++i)
+      s += "Hello, world\n";
+    buffer_.Append(s.data(), s.size());
+  }
+
+  void TearDown() override {
+    ::close(fds_[0]);
+    if (fds_[1] >= 0)
+      ::close(fds_[1]);
+    ::close(out_);
+  }
+
+  void Send(const char *keys) {
+    ASSERT_TRUE(::write(fds_[1], keys, strlen(keys)) == ssize_t(strlen(keys)));
+  }
+
+  int fds_[2];
+  int out_;
+  editor::MonoBuffer buffer_;
+};
+
+TEST_F(WindowTest, OneFramePerBurst) {
+  editor::BufferView view(&buffer_, 10, 40);
+  tui::ANSITerminal vt(fds_[0], out_);
+  // A frame every 200ms, keys of the burst arrive well within one interval.
+  Window window(10, 40, view, vt, 5);
+  std::thread keys([this] {
+    for (int i = 0; i < 4; ++i) {
+      Send("j");
+      std::this_thread::sleep_for(2ms);
+    }
+    std::this_thread::sleep_for(500ms);
+    Send("\x1B");
+  });
+  EXPECT_TRUE(window.Run(fds_[0]) == 0);
+  keys.join();
+  // The first frame, then one for the whole burst.
+  EXPECT_TRUE(window.num_frames() == 2);
+  EXPECT_TRUE(window.input_latency().count() == 4);
+  EXPECT_TRUE(window.input_latency().max() < 1000000);
+}
+
+TEST_F(WindowTest, EndOfInput) {
+  editor::BufferView view(&buffer_, 10, 40);
+  tui::ANSITerminal vt(fds_[0], out_);
+  Window window(10, 40, view, vt, 0);
+  ::close(fds_[1]);
+  fds_[1] = -1;
+  EXPECT_TRUE(window.Run(fds_[0]) == 0);
+  EXPECT_TRUE(window.num_frames() == 1);
+  EXPECT_TRUE(window.input_latency().count() == 0);
+}
+
+} // namespace
@@ -0,0 +1,182 @@
+#include "editor/line_view.h"
+#include "editor/wrap_index.h"
+#include "support/random.h"
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <time.h>
+
+namespace {
+
+using namespace emcc::editor;
+
+// Layout all lines and compare with LineView.
+void ExpectExact(MonoBuffer &buffer, WrapIndex &index) {
+  index.Layout(0, MonoBuffer::npos);
+  EXPECT_TRUE(index.NumLaidOutLines() == buffer.NumLines());
+  EXPECT_TRUE(index.Refine(1) == 0);
+  size_t row = 0;
+  for (size_t line = 0; line < buffer.NumLines(); ++line) {
+    const size_t height = LineView(&buffer, line, index.width()).height();
+    ASSERT_TRUE(index.GetRow(line) == row);
+    ASSERT_TRUE(index.GetHeight(line) == height);
+    row += height;
+  }
+  EXPECT_TRUE(index.NumRows() == row);
+}
+
+TEST(WrapIndexTest, Locate) {
+  std::string s;
+  for (int i = 0; i < 1000; ++i)
+    s += std::string(i % 37, 'a') + "世界\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  WrapIndex index(&buffer, 8);
+  EXPECT_TRUE(index.NumLaidOutLines() == 0);
+  // Jump far away, only the line at the row is laid out.
+  auto pos = index.Locate(2000);
+  ASSERT_TRUE(pos.has_value());
+  EXPECT_TRUE(index.IsLaidOut(pos->first));
+  EXPECT_TRUE(index.GetRow(pos->first) + pos->second == 2000);
+  EXPECT_TRUE(pos->second < index.GetHeight(pos->first));
+  ExpectExact(buffer, index);
+  for (size_t row = 0; row < index.NumRows(); row += 7) {
+    pos = index.Locate(row);
+    ASSERT_TRUE(pos.has_value());
+    EXPECT_TRUE(index.GetRow(pos->first) + pos->second == row);
+  }
+  EXPECT_FALSE(index.Locate(index.NumRows()).has_value());
+  EXPECT_TRUE(index.GetRow(buffer.NumLines()) == index.NumRows());
+  EXPECT_TRUE(index.GetRow(buffer.NumLines() + 5) == index.NumRows());
+  index.Resize(16);
+  EXPECT_TRUE(index.NumLaidOutLines() == 0);
+  while (index.Refine(100))
+    ;
+  ExpectExact(buffer, index);
+}
+
+TEST(WrapIndexTest, LazyResize) {
+  emcc::Random rnd(std::time(nullptr));
+  std::string s;
+  for (int i = 0; i < 3000; ++i)
+    s += std::string(i % 37, 'a') + "\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  WrapIndex index(&buffer, 8);
+  EXPECT_TRUE(index.NumEstimatedLines() == buffer.NumLines());
+  index.Resize(5);
+  EXPECT_TRUE(index.NumEstimatedLines() == 0);
+  // Lines in view are exact before others are estimated.
+  index.Layout(1000, 1050);
+  EXPECT_TRUE(index.NumEstimatedLines() == 50);
+  for (size_t line = 1000; line < 1050; ++line) {
+    ASSERT_TRUE(index.GetHeight(line) ==
+                LineView(&buffer, line, 5).height());
+  }
+  // Edits while lines are at the previous width.
+  for (int i = 0; i < 20; ++i) {
+    size_t offset;
+    buffer.ComputeOffset(rnd.Next() * buffer.NumLines(), 0, offset);
+    if (rnd.Next() < 0.5)
+      buffer.Insert(offset, std::string(17, 'b') + "\n");
+    else
+      buffer.Erase(offset, 1);
+  }
+  while (index.NumEstimatedLines() < buffer.NumLines())
+    ASSERT_TRUE(index.Refine(100) > 0);
+  for (size_t line = 0; line < buffer.NumLines(); ++line) {
+    if (index.IsLaidOut(line))
+      continue;
+    const size_t size = buffer.GetLineSize(line);
+    ASSERT_TRUE(index.GetHeight(line) == long(std::max(1UL, (size + 4) / 5)));
+  }
+  ExpectExact(buffer, index);
+}
+
+TEST(WrapIndexTest, ZeroWidth) {
+  std::string s;
+  for (int i = 0; i < 100; ++i)
+    s += std::string(i % 7, 'a') + "世界\n";
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  // Taken as one column.
+  WrapIndex index(&buffer, 0);
+  EXPECT_TRUE(index.width() == 1);
+  ExpectExact(buffer, index);
+  index.Resize(8);
+  index.Resize(0);
+  EXPECT_TRUE(index.width() == 1);
+  ExpectExact(buffer, index);
+  LineView lv(&buffer, 3, 0);
+  EXPECT_TRUE(lv.width() == 1);
+  EXPECT_TRUE(lv.height() == LineView(&buffer, 3, 1).height());
+}
+
+TEST(WrapIndexTest, Edit) {
+  emcc::Random rnd(std::time(nullptr));
+  MonoBuffer buffer;
+  std::string s(300, 'a');
+  for (size_t i = 0; i < s.size(); i += 1 + 50 * rnd.Next())
+    s[i] = '\n';
+  buffer.Append(s.data(), s.size());
+  WrapIndex index(&buffer, 10);
+  index.Layout(0, MonoBuffer::npos);
+  for (int i = 0; i < 200; ++i) {
+    const size_t offset = rnd.Next() * (buffer.size() + 1);
+    const double p = rnd.Next();
+    if (p < 0.5)
+      buffer.Insert(offset, rnd.Next() < 0.2 ? '\n' : 'b');
+    else if (p < 0.7)
+      buffer.Insert(offset, std::string(30 * rnd.Next(), 'c') + "\n");
+    else
+      buffer.Erase(offset, 40 * rnd.Next());
+    // Edited lines are estimated, the others stay laid out.
+    EXPECT_TRUE(index.NumLaidOutLines() <= buffer.NumLines());
+    if (i % 10 == 0)
+      ExpectExact(buffer, index);
+  }
+  ExpectExact(buffer, index);
+}
+
+TEST(WrapIndexTest, Background) {
+  emcc::Random rnd(std::time(nullptr));
+  std::string s;
+  for (int i = 0; i < 20000; ++i)
+    s += std::string(rnd.Next() * 100, 'a') + (i % 3 ? "世界\n" : "\n");
+  MonoBuffer buffer;
+  buffer.Append(s.data(), s.size());
+  emcc::ThreadPool pool(4);
+  WrapIndex index(&buffer, 8, &pool);
+  // Lines in view first, the others in background.
+  index.Layout(100, 150);
+  while (!index.Sync())
+    std::this_thread::yield();
+  ExpectExact(buffer, index);
+  // Edits while lines are being laid out.
+  index.Resize(13);
+  for (int i = 0; i < 200; ++i) {
+    const size_t offset = rnd.Next() * (buffer.size() + 1);
+    if (rnd.Next() < 0.5)
+      buffer.Insert(offset, std::string(30 * rnd.Next(), 'c') + "\n");
+    else
+      buffer.Erase(offset, 100 * rnd.Next());
+    index.Sync();
+  }
+  while (!index.Sync())
+    std::this_thread::yield();
+  ExpectExact(buffer, index);
+}
+
+TEST(WrapIndexTest, Destroy) {
+  MonoBuffer buffer;
+  {
+    WrapIndex index(&buffer, 10);
+    buffer.Append("abc\n", 4);
+    EXPECT_TRUE(index.NumRows() == 1);
+  }
+  // The callback is removed.
+  buffer.Append("def\n", 4);
+  EXPECT_TRUE(buffer.NumLines() == 2);
+}
+
+} // namespace